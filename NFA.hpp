@@ -4,18 +4,43 @@
 #include <pz_cxx_std.hpp>
 #include <pz_types.hpp>
 #include <pz_error.hpp>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 /** @brief namespace PzRegex */
 namespace PzRegex {
-enum StateType;      // NFA state types
-enum AssertionType;  // Assertion types for regex anchors
+enum class StateType : st32;     // NFA state types
+enum class AssertionType : st32; // Assertion types for regex anchors
+enum class PrefilterType : st32; // Candidate scanner kinds
+enum class NodeType : st32;      // Pattern tree node kinds
 struct CharClass;    // Character class representation
 struct State;        // NFA state node
-struct PtrList;      // Linked list for patching transitions
+struct Hole;         // Dangling transition awaiting a target
+struct PatchList;    // Head/tail list of holes
+class Arena;         // Bump allocator owning an NFA graph
 struct Frag;         // NFA fragment during construction
+struct Node;         // Pattern tree node between parsing and the NFA
 struct CaptureGroup; // Capture group information
-class NFABuilder;    // NFA construction from postfix regex
+struct MatchSpan;    // Position of a match in the input
+struct MatchSet;     // Pattern ids matched by a RegexSet
+struct Inst;         // Compiled NFA instruction
+class Prefilter;     // Literal scanner for candidate match starts
+class GlushkovNFA;   // Epsilon-free position automaton of a Prog
+class OnePass;       // Single-thread capture engine for one-pass patterns
+struct Prog;         // Flat compiled NFA program
+class NFABuilder;    // NFA construction from postfix or infix regex
+class InfixParser;   // Infix regex syntax to a pattern tree
+class AstOptimizer;  // Pattern tree rewrites before NFA construction
+class Backtracker;   // Memoized backtracking for short inputs
 class NFASimulator;  // NFA simulation engine
+class LazyDFA;       // On-demand DFA for capture-free matching
+class RegexSet;      // Many patterns matched in one pass
+class Regex;         // Immutable compiled pattern, shareable by threads
+class WorkPool;      // Work-stealing thread pool for batch matching
+class ParallelScan;  // Chunked parallel DFA scan of one buffer
+class StreamMatcher; // Incremental matching of chunked input
+class RegexCache;    // Process-wide LRU cache of compiled patterns
 }; // namespace PzRegex
 
 /**
@@ -32,7 +57,8 @@ enum class PzRegex::StateType : st32 {
   STATE_CHARCLASS,     // Character class [a-z]
   STATE_ASSERTION,     // ^, $, \b
   STATE_CAPTURE_START, // Start of capture group
-  STATE_CAPTURE_END    // End of capture group
+  STATE_CAPTURE_END,   // End of capture group
+  STATE_REPEAT         // Counted repetition x{n,m} of one class
 };
 
 /**
@@ -48,23 +74,82 @@ enum class PzRegex::AssertionType : st32 {
   ASSERT_WORD_BOUND  // \b - Word boundary
 };
 
+/**
+ * @name Prefilter type enumeration
+ * @brief How a Prefilter looks for candidate match starts.
+ */
+enum class PzRegex::PrefilterType : st32 {
+  PREFILTER_NONE = 0,    // No required literal, every position is a candidate
+  PREFILTER_BYTE,        // Single required byte (memchr)
+  PREFILTER_LITERAL,     // Required literal string (memmem)
+  PREFILTER_TEDDY,       // Small literal set (packed SIMD nibble masks)
+  PREFILTER_AHO_CORASICK // Large literal set (Aho-Corasick automaton)
+};
+
+/**
+ * @name Pattern tree node type enumeration
+ * @brief Kinds of Node in the tree built before the NFA.
+ */
+enum class PzRegex::NodeType : st32 {
+  NODE_EMPTY = 0, // Matches ""
+  NODE_LITERAL,   // Byte string
+  NODE_CLASS,     // One byte out of a class
+  NODE_ASSERTION, // ^, $, \b
+  NODE_CONCAT,    // Children in sequence
+  NODE_ALTERNATE, // Children tried in order
+  NODE_REPEAT,    // Child {min,max}
+  NODE_CAPTURE    // Child inside a capture group
+};
+
 // Convenience type aliases
 using PzStateType = PzRegex::StateType;
 using PzAssertionType = PzRegex::AssertionType;
 
+namespace PzRegex {
+/**
+ * @brief Index of the lowest set bit of m, which must not be 0
+ * @details
+ * Walks the position, slot and bucket bit sets. MSVC has no
+ * __builtin_ctzll, so it scans with _BitScanForward(64) instead.
+ */
+inline ut32 lowestBit(ut64 m) {
+#if defined(_MSC_VER)
+  unsigned long i;
+#if defined(_M_X64) || defined(_M_ARM64)
+  _BitScanForward64(&i, m);
+#else
+  if (!_BitScanForward(&i, static_cast<unsigned long>(m))) {
+    _BitScanForward(&i, static_cast<unsigned long>(m >> 32));
+    i += 32;
+  }
+#endif
+  return static_cast<ut32>(i);
+#else
+  return static_cast<ut32>(__builtin_ctzll(m));
+#endif
+}
+} // namespace PzRegex
+
 /**
  * @brief Character class for pattern matching
+ * @details
+ * A 256-bit bitmap with one bit per byte value. Negation is applied to the
+ * bitmap when the class is built, so a test is a single bit lookup.
  */
 namespace PzRegex {
 struct CharClass {
-  std::set<char> chars; // Characters in the class
-  bool negated = false; // If true, matches characters NOT in set
+  std::array<ut64, 4> bits = {}; // Bit b set = byte b is in the class
 
   CharClass() = default;
 
   void addRange(char start, char end); // Add character range [start-end]
   void addChar(char c);                // Add single character
-  bool matches(char c) const;          // Check if character matches class
+  void negate();                       // Complement the class in place
+  bool matches(char c) const {         // Check if character matches class
+    ut8 b = static_cast<ut8>(c);
+    return (bits[b >> 6] >> (b & 63)) & 1;
+  }
+  bool operator==(const CharClass &o) const { return bits == o.bits; }
 };
 
 /**
@@ -75,13 +160,15 @@ struct State {
   st32 c;                            // Character for STATE_CHAR
   State *out = nullptr;              // First transition (raw pointer)
   State *out1 = nullptr;             // Second transition (raw pointer for SPLIT)
-  st32 lastlist = 0;                 // Bookkeeping for simulation
 
   // Extended features
-  std::unique_ptr<CharClass> charClass = nullptr; // For STATE_CHARCLASS
-  AssertionType assertion = ASSERT_NONE;          // For STATE_ASSERTION
+  st32 classIndex = -1;                           // For STATE_CHARCLASS
+  AssertionType assertion = AssertionType::ASSERT_NONE; // For STATE_ASSERTION
   st32 captureIndex = -1;                         // For capture groups
   bool greedy = true; // Greedy vs non-greedy matching
+  st32 repeatMin = 0;  // For STATE_REPEAT
+  st32 repeatMax = -1; // For STATE_REPEAT (-1 = unbounded)
+  ut32 id = 0;        // Index in the builder's state table
 
   State(StateType t, st32 ch = 0, State *o = nullptr, State *o1 = nullptr);
 
@@ -89,24 +176,55 @@ struct State {
 };
 
 /**
- * @brief Linked list of state pointers for patching
+ * @brief Dangling transition of a fragment
+ * @details
+ * Named by index rather than by address: slot is 2 * state id, plus one
+ * for out1, so a clone of the fragment finds its own hole by lookup.
  */
-struct PtrList {
-  State **p;                         // Pointer to a State raw pointer
-  std::unique_ptr<PtrList> next;     // Next item in list
+struct Hole {
+  ut32 slot;                         // 2 * State::id + (0 for out, 1 for out1)
+  Hole *next = nullptr;              // Next hole in the list (arena-owned)
 
-  PtrList(State **ptr, std::unique_ptr<PtrList> n = nullptr);
+  Hole(ut32 s);
+};
+
+/**
+ * @brief List of holes with a tail pointer, so appending is O(1)
+ */
+struct PatchList {
+  Hole *head = nullptr;              // First hole, nullptr when empty
+  Hole *tail = nullptr;              // Last hole
 };
 
 /**
  * @brief NFA fragment during construction
  */
 struct Frag {
-  std::unique_ptr<State> start;      // Start state of fragment (owned)
-  std::unique_ptr<PtrList> out;      // Dangling output pointers
+  State *start;                      // Start state of fragment (arena-owned)
+  PatchList out;                     // Dangling output pointers
 
-  Frag(std::unique_ptr<State> s = nullptr,
-       std::unique_ptr<PtrList> o = nullptr);
+  Frag(State *s = nullptr, PatchList o = PatchList());
+};
+
+/**
+ * @brief Node of the pattern tree (arena-owned)
+ * @details
+ * Children form a list through next, so a node stays trivially
+ * destructible and the optimizer can splice and rewrite the tree in place.
+ */
+struct Node {
+  NodeType type;                     // Kind of node
+  Node *child = nullptr;             // First child
+  Node *next = nullptr;              // Next sibling
+  std::string_view text;             // NODE_LITERAL bytes (arena-owned)
+  CharClass cc;                      // NODE_CLASS
+  AssertionType assertion = AssertionType::ASSERT_NONE; // NODE_ASSERTION
+  st32 min = 0;                      // NODE_REPEAT
+  st32 max = -1;                     // NODE_REPEAT (-1 = unbounded)
+  bool greedy = true;                // NODE_REPEAT
+  st32 capture = -1;                 // NODE_CAPTURE group index
+
+  Node(NodeType t);
 };
 
 /**
@@ -119,66 +237,971 @@ struct CaptureGroup {
 };
 
 /**
- * @brief NFA builder from postfix regex
+ * @brief Position of a match in the input
+ */
+struct MatchSpan {
+  st64 start = -1; // First byte of the match (-1 = no match)
+  st64 end = -1;   // One past the last byte of the match
+};
+
+/**
+ * @brief Set of pattern ids, one bit per pattern
+ */
+struct MatchSet {
+  std::vector<ut64> words; // Bit i of the set = pattern i matched
+
+  void reset(size_t n);         // Room for n ids, all cleared
+  void insert(ut32 id);         // Mark id as matched
+  bool contains(ut32 id) const; // Test id
+  bool empty() const;           // No id matched
+  size_t count() const;         // Number of matched ids
+};
+
+/**
+ * @brief Compiled NFA instruction
+ * @details
+ * One State lowered into 16 bytes. Successors are 32-bit indices into
+ * Prog::insts and character classes live in Prog::classes, so engines
+ * walk one contiguous array instead of chasing heap pointers.
+ */
+struct Inst {
+  ut8 op;     // StateType of the source state
+  ut8 greedy; // STATE_SPLIT: 1 = prefer out, 0 = prefer out1
+  ut16 pad;   // Unused
+  st32 arg;   // Byte, class, AssertionType, capture or repeat index
+  ut32 out;   // First successor
+  ut32 out1;  // Second successor (STATE_SPLIT)
+
+  StateType type() const { return static_cast<StateType>(op); }
+};
+
+/**
+ * @brief Scanner for positions where a match can start
+ * @details
+ * Built from a Prog by following the STATE_CHAR chains behind the start,
+ * branching at the splits of leading alternations and at small leading
+ * classes, and skipping zero-width instructions. Every match begins with
+ * one of the collected literals, so an unanchored search only needs to
+ * start threads where find() reports one. A single literal is scanned
+ * memchr/memmem style, up to kTeddyMaxLiterals with Teddy (SSSE3 nibble
+ * masks) and larger sets with an Aho-Corasick automaton. Vector paths
+ * are used when the compiler targets them; otherwise scalar loops take
+ * over. The exception is Teddy on x86-64 GCC and Clang: its SSSE3 loop is
+ * always built and picked at run time when the CPU has SSSE3, so no
+ * -mssse3 is needed.
+ */
+class Prefilter {
+private:
+  static constexpr size_t kMaxLiterals = 4096;   // Give up beyond this
+  static constexpr size_t kMaxLiteralLen = 32;   // Prefix length cap
+  static constexpr size_t kMaxClassFanout = 16;  // Widest class expanded
+  static constexpr size_t kMaxClassPaths = 64;   // Paths a class may fork to
+  static constexpr size_t kTeddyMaxLiterals = 32; // Teddy vs Aho-Corasick
+  static constexpr ut32 kTeddyBuckets = 8;        // One bit per bucket
+  static constexpr ut32 kTeddyMaxFingerprint = 3; // Leading bytes masked
+
+  PrefilterType type_;                // Scanner kind
+  std::vector<std::string> literals_; // Every match starts with one of these
+  size_t min_len_ = 0;                // Shortest literal
+  size_t max_len_ = 0;                // Longest literal
+
+  // PREFILTER_TEDDY
+  ut32 teddy_len_ = 0;                    // Fingerprint bytes
+  std::vector<ut8> teddy_masks_;          // lo/hi nibble masks per byte
+  std::array<ut8, 256> teddy_first_ = {}; // Buckets by first byte (scalar)
+  std::vector<std::vector<ut32>> buckets_; // Literal indices per bucket
+
+  // PREFILTER_AHO_CORASICK
+  std::array<ut8, 256> ac_class_ = {}; // Byte -> equivalence class
+  ut32 ac_stride_ = 0;                 // Classes per state row
+  std::vector<ut32> ac_delta_;         // Full transition table
+  std::vector<ut32> ac_out_;           // Longest literal ending here, 0 = none
+
+  void buildTeddy();       // Fill the nibble masks and buckets
+  void buildAhoCorasick(); // Build the trie, failure links and table
+  size_t findTeddy(const char *p, size_t n) const;
+  size_t findTeddyBlocks(const char *p, size_t n,
+                         size_t *from) const; // SSSE3 part of findTeddy
+  size_t findAhoCorasick(const char *p, size_t n) const;
+  bool verifyBuckets(const char *p, size_t n, size_t at,
+                     ut32 buckets) const; // Literal of a bucket at p + at
+
+public:
+  static constexpr size_t npos = std::string_view::npos; // Not found
+
+  Prefilter();
+
+  static Prefilter fromProg(const Prog &prog); // Extract the prefixes
+  PrefilterType type() const;                  // Scanner kind
+  bool empty() const;                          // No usable literal
+  const std::vector<std::string> &literals() const; // Required prefixes
+  size_t bytes() const;                        // Memory held by the tables
+  size_t find(std::string_view s,
+              size_t from) const; // First candidate start >= from
+};
+
+/**
+ * @brief Position (Glushkov) automaton: the Prog without ε-instructions
+ * @details
+ * Positions are the thread ids that consume a byte (STATE_CHAR,
+ * STATE_CHARCLASS and the counts of a STATE_REPEAT), plus position 0
+ * standing for the start. Each position lists the positions that may
+ * consume the next byte, found by following the ε-closure of its
+ * successor once, at build time, in the Pike VM's priority order. The
+ * splits disappear; assertions met on the way become conditions on the
+ * edge and capture instructions become the slots the edge sets. So the
+ * start edges are the Glushkov first set, the edges into kAccept the last
+ * set and the rest the follow sets.
+ *
+ * With at most kMaxParallel positions match() and search() run
+ * bit-parallel: the live positions are one word, and a byte costs a
+ * table lookup per 8 positions plus a mask with the positions that
+ * accept it. Captures are not tracked there; the edges keep them for
+ * engines that do. Programs over kMaxIds thread ids are not converted.
+ */
+class GlushkovNFA {
+public:
+  static constexpr ut32 kAccept = UT32_MAX; // Edge target: the match
+  static constexpr ut32 kMaxIds = 1024;     // Largest Prog converted
+  static constexpr ut32 kMaxParallel = 64;  // Positions in one word
+
+  /** @brief Move to a position, or to the match */
+  struct Edge {
+    ut32 to;      // Position entered, or kAccept
+    ut32 asserts; // 1 << AssertionType for each assertion that must hold
+    ut64 slots;   // Capture slots set to the offset of the boundary
+  };
+
+private:
+  std::vector<ut32> ids_;          // Position -> thread id (start: kNone)
+  std::vector<CharClass> classes_; // Position -> bytes it consumes
+  std::vector<ut32> first_edge_;   // Position -> first edge, plus an end
+  std::vector<Edge> edges_;        // Edges of each position, by priority
+
+  // Bit-parallel tables (size() <= kMaxParallel), bit p = position p
+  std::array<ut64, 256> consumes_ = {};      // Byte -> positions taking it
+  std::vector<std::array<ut64, 256>> next_;  // 8 positions -> edge targets
+  ut64 accept_ = 0;                          // Unconditional accept edges
+  ut64 guarded_ = 0;                         // Positions with conditions
+
+  ut64 follow(ut64 live, st32 prev, st32 next) const; // Targets at a boundary
+  bool accepts(ut64 live, st32 prev, st32 next) const; // Match at a boundary
+
+public:
+  static GlushkovNFA fromProg(const Prog &prog); // ε-elimination
+  static bool holds(ut32 asserts, st32 prev,
+                    st32 next); // Conditions between two bytes (-1: edge)
+
+  bool empty() const;             // Not built: program too large
+  ut32 size() const;              // Positions, counting the start
+  ut32 id(ut32 p) const;          // Thread id of position p
+  const CharClass &classOf(ut32 p) const; // Bytes position p consumes
+  const Edge *edges(ut32 p) const; // Edges of p, highest priority first
+  ut32 edgeCount(ut32 p) const;    // Number of edges of p
+  bool parallel() const;          // match() and search() are available
+  bool match(std::string_view s) const;  // Full match, bit-parallel
+  bool search(std::string_view s) const; // Any match, bit-parallel
+  size_t bytes() const;           // Memory held by the automaton
+};
+
+/**
+ * @brief Capture engine for patterns where the next byte picks the path
+ * @details
+ * A pattern is one-pass when, from every position of its GlushkovNFA,
+ * the positions it can move to consume disjoint sets of bytes. Then at
+ * most one thread is ever alive, so its capture slots are written in
+ * place and nothing is copied. Bytes that no position tells apart share
+ * a byte class, and each position has one table row naming the single
+ * edge a byte class can take. Edges into the match stay in a short list
+ * per position, ordered against that edge by priority, so leftmost-first
+ * choices come out as in the Pike VM. An edge with conditions is checked
+ * when the table picks it.
+ *
+ * exec() runs anchored at one offset; NFASimulator tries offsets in turn
+ * to search. compile() and join() build it from the program's GlushkovNFA.
+ */
+class OnePass {
+public:
+  static constexpr ut32 kNoEdge = UT32_MAX;    // Table cell: byte stops here
+  static constexpr size_t kMaxCells = 1 << 14; // Largest table built
+
+private:
+  std::array<ut8, 256> byte_class_ = {};   // Byte -> byte class
+  ut32 classes_ = 0;                       // Number of byte classes
+  ut32 width_ = 0;                         // Capture slots, span pair last
+  std::vector<ut32> table_;                // Position * classes_ -> edge
+  std::vector<GlushkovNFA::Edge> edges_;   // Every edge of the automaton
+  std::vector<ut32> first_accept_;         // Position -> first in accepts_
+  std::vector<ut32> accepts_;              // Edges into the match, by priority
+
+public:
+  static OnePass fromProg(const Prog &prog); // Empty unless one-pass
+
+  bool empty() const;  // Not one-pass, or not built
+  ut32 width() const;  // Slots exec() fills
+  bool exec(std::string_view s, size_t at, bool full, st64 *slots,
+            st64 *out, size_t *work) const; // Anchored run from at
+  size_t bytes() const; // Memory held by the tables
+};
+
+/**
+ * @brief Flat, index-based NFA program shared by all engines
+ * @details
+ * compile() appends an unanchored entry: a non-greedy loop over any byte
+ * whose exit records the match start in capture slot pair num_captures
+ * and then jumps to start. Searching from there finds the leftmost match
+ * in a single pass.
+ *
+ * join() builds a set program from bodies made by compileBody(), which
+ * stops before the unanchored entry and the tables: one split chain fans
+ * out to every pattern, each keeps its own STATE_MATCH with the pattern id
+ * in arg, and `match` is kNone. The entry and tables are then built once,
+ * for the joined program.
+ */
+struct Prog {
+  static constexpr ut32 kNone = UT32_MAX; // Missing successor
+
+  /**
+   * @brief Counted repetition of one class (STATE_REPEAT)
+   * @details
+   * A thread inside the repetition is told apart by how many bytes it
+   * has consumed: count 0 is the instruction itself and count c > 0 gets
+   * the thread id size() + base + c - 1. Counts past min of an unbounded
+   * repetition behave alike and share the id of count min.
+   */
+  struct Repeat {
+    ut32 pc;   // The STATE_REPEAT instruction
+    st32 cls;  // Class index of the repeated byte
+    ut32 min;  // Repetitions before the exit opens
+    ut32 max;  // Most repetitions, kNone = unbounded
+    ut32 base; // First count id, relative to size()
+  };
+
+  std::vector<Inst> insts;        // Instructions, start first
+  std::vector<CharClass> classes; // Class table for STATE_CHARCLASS
+  ut32 start = 0;                 // Entry instruction
+  ut32 match = kNone;             // Accepting instruction
+  ut32 unanchored = kNone;        // Entry behind a non-greedy .*? loop
+  st32 num_captures = 0;          // Number of capture groups
+  Prefilter prefilter;            // Required literal prefixes, if any
+  std::vector<Repeat> repeats;    // Counted repetitions, ascending base
+  ut32 count_ids = 0;             // Thread ids past size() for counts
+  GlushkovNFA glushkov;           // ε-free form (not compileBody())
+  OnePass onepass;                // Set when the pattern is one-pass
+  std::shared_ptr<const Prog> reverse; // Backwards body only (Regex)
+
+  static Prog compile(State *start, State *match, st32 numCaptures,
+                      const std::vector<CharClass> &classes); // Lower a State graph
+  static Prog compileBody(State *start, State *match, st32 numCaptures,
+                          const std::vector<CharClass> &classes); // For join()
+  static Prog join(const std::vector<Prog> &progs); // Set of patterns
+  static void appendUnanchored(Prog &prog); // Add the .*? entry
+  ut32 size() const;                     // Number of instructions
+  size_t bytes() const;                  // Memory held by the program
+  ut32 ids() const;   // Thread ids: instructions plus repeat counts
+  ut32 pcOf(ut32 id, ut32 *count = nullptr) const; // Instruction of an id
+  ut32 advance(ut32 id) const; // Id once a STATE_REPEAT thread consumes
+};
+
+/**
+ * @brief Bump allocator that owns every node of one NFA graph
+ * @details
+ * Nodes are carved out of blocks that double in size, and are never freed
+ * one at a time: the blocks are released together when the arena goes.
+ * Only trivially destructible types may be allocated here.
+ */
+class Arena {
+private:
+  static constexpr size_t kFirstBlock = 4 << 10;  // Size of the first block
+  static constexpr size_t kMaxBlock = 1 << 20;    // Growth stops here
+
+  std::vector<std::unique_ptr<char[]>> blocks_; // Owned memory
+  char *next_ = nullptr;                        // Free space in the last block
+  size_t left_ = 0;                             // Bytes left after next_
+  size_t next_block_ = kFirstBlock;             // Size of the next block
+  size_t used_ = 0;                             // Bytes in all blocks
+
+  void *allocate(size_t size, size_t align); // Aligned bump allocation
+
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arena objects are never destroyed");
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+  std::string_view copy(std::string_view s); // Arena-owned copy of s
+  size_t bytes() const; // Memory held by the arena
+};
+
+/**
+ * @brief NFA builder from postfix or infix regex
+ * @details
+ * build() reads postfix text and parse() infix syntax (see InfixParser).
+ * Both produce a pattern tree, run it through AstOptimizer and lower the
+ * result with the same private fragment combinators. Every Node, State
+ * and Hole is allocated from the builder's arena, so the graph returned is
+ * borrowed: it stays valid as long as the builder and is freed with it in
+ * one go. Lower it with compile() to keep a program that outlives the
+ * builder.
+ *
+ * x{n,m} of a single byte or class becomes one STATE_REPEAT whatever the
+ * counts; other bodies are copied n times plus m - n optional copies.
+ *
+ * With reversed set the tree is mirrored before lowering: sequences and
+ * literals run backwards and ^ and $ trade places, so the NFA matches
+ * exactly the reversals of what the pattern matches. Priorities mean
+ * nothing there; it is only run to find where a match starts.
  */
 class NFABuilder {
 private:
-  State *matchstate_; // The accepting state (non-owning)
+  Arena arena_;       // Owns tree nodes, states and patch-list nodes
+  State *matchstate_; // The accepting state (arena-owned)
   st32 next_capture_index_ = 0;       // Counter for capture groups
+  std::vector<CharClass> classes_;    // Deduplicated class table
+  std::map<std::array<ut64, 4>, st32> class_ids_; // Bitmap -> table index
+  std::vector<State *> states_;       // State::id -> state
+  std::vector<State *> clone_of_;     // State::id -> copy made by cloneFrag
+
+  st32 internClass(const CharClass &cc); // Index of cc in classes_
+
+  State *newState(StateType t, st32 ch = 0, State *o = nullptr,
+                  State *o1 = nullptr);         // Arena state with an id
+  PatchList hole(State *s, bool second);        // One-hole list for s
+  void patch(PatchList l, State *s);            // Patch dangling pointers
+  static PatchList append(PatchList l1, PatchList l2); // Join in O(1)
+  Frag cloneFrag(const Frag &f);                // Copy of an unpatched frag
+
+  Frag literal(char c);                         // One byte
+  Frag charClass(const CharClass &cc);          // One byte out of a class
+  Frag assertion(AssertionType a);              // Zero-width check
+  Frag empty();                                 // Matches ""
+  Frag openCapture(st32 index);                 // Group index's start
+  Frag closeCapture(Frag open, Frag body);      // open body end
+  Frag concat(Frag e1, Frag e2);                // e1 e2
+  Frag alternate(Frag e1, Frag e2);             // e1 | e2, e1 first
+  Frag repeat(Frag e, st32 min, st32 max,
+              bool greedy);                     // e{min,max}, max -1 = inf
+  State *finish(Frag e);                        // Patch e to the match
 
-  static void patch(PtrList *l, State *s); // Patch dangling pointers
-  static std::unique_ptr<PtrList>
-  append(std::unique_ptr<PtrList> l1,
-         std::unique_ptr<PtrList> l2); // Append PtrLists
+  Node *newNode(NodeType t);                    // Arena tree node
+  Node *fromPostfix(const std::string &postfix); // Postfix text to a tree
+  Frag lower(Node *root);                       // Tree to fragments
+  void mirror(Node *root);                      // Tree for reversed input
+
+  friend class InfixParser;
+  friend class AstOptimizer;
 
 public:
   NFABuilder();
 
-  std::unique_ptr<State>
-  build(const std::string &postfix); // Build NFA from postfix regex
+  State *build(const std::string &postfix,
+               bool reversed = false); // Build NFA (builder-owned)
+  State *parse(std::string_view pattern,
+               bool reversed = false); // Same, from infix syntax
   State *get_match_state() const;    // Get match state
   st32 get_capture_count() const;    // Get capture group count
+  const std::vector<CharClass> &get_classes() const; // Get class table
+  Prog compile(State *start) const;  // Lower a built NFA to a Prog
+  Prog compileBody(State *start) const; // Same, for Prog::join
+};
+
+/**
+ * @brief Single-pass parser from the usual infix regex syntax to a tree
+ * @details
+ * Reads the pattern once into the builder's pattern tree, so there is no
+ * postfix text and no intermediate string. Supports groups ( ) and (?: ),
+ * classes [...] with ranges and negation, the escapes \d \w \s (and
+ * upper-case complements), \b, \n, \t, \r, \f, \v, \xHH, the
+ * any-byte-but-newline dot, anchors ^ $, and the quantifiers * + ? {n}
+ * {n,} {n,m} with non-greedy *? +? and ??. Open groups live on an
+ * explicit stack rather than the call stack, so nesting depth is bounded
+ * only by memory. Malformed patterns are reported through
+ * PzError::report_error with the byte offset.
+ */
+class InfixParser {
+private:
+  struct Group {
+    Node *alt;      // NODE_ALTERNATE collecting the closed alternatives
+    Node *alt_last; // Last closed alternative
+    Node *seq;      // NODE_CONCAT of the open alternative
+    Node *seq_last; // Last item of seq
+    Node *capture;  // NODE_CAPTURE, nullptr for (?: and the top
+    size_t at;      // Offset of the (, for errors
+  };
+
+  NFABuilder &b_;             // Allocates the nodes
+  std::string_view pattern_;  // Infix source
+  size_t pos_ = 0;            // Next byte to read
+  std::vector<Group> groups_; // Open groups, top level first
+
+  Group openGroup(Node *capture);         // Empty group at pos_
+  void closeAlternative(Group &g);        // Move seq into alt
+  Node *closeGroup();                     // Pop the innermost group
+  Node *parseAtom();                      // Class, escape, dot or byte
+  Node *parseQuantifiers(Node *e);        // Quantifiers after an atom
+  void parseClass(CharClass *cc);         // [...] after the opening [
+  bool parseClassEscape(CharClass *cc);   // \d \w \s and complements
+  char parseEscapedByte();                // Byte named by an escape
+  bool parseCount(st32 *min, st32 *max);  // {n}, {n,}, {n,m}
+  void fail(const char *what) const;      // Report at pos_
+
+public:
+  InfixParser(NFABuilder &builder, std::string_view pattern);
+
+  Node *parse(); // Whole pattern as an unoptimized tree
+};
+
+/**
+ * @brief Rewrites a pattern tree into an equivalent one with fewer states
+ * @details
+ * Runs bottom-up over the tree with an explicit stack. Adjacent literals
+ * merge into one string node, alternation branches that start with the
+ * same literal are factored into a trie (cat|car|cab becomes ca(?:t|r|b)),
+ * runs of single-byte branches fold into one class (a|b|c becomes [abc])
+ * and a ?, * or + directly inside the same quantifier collapses into one
+ * (x** is x*). Only adjacent branches are merged, so leftmost-first
+ * priority is unchanged, and nothing is moved across a capture group.
+ */
+class AstOptimizer {
+private:
+  struct Visit {
+    Node *node;    // Node to simplify
+    bool ready;    // Children already simplified
+  };
+
+  NFABuilder &b_;            // Allocates new nodes
+  std::vector<Visit> todo_;  // Explicit post-order stack
+
+  void simplify(Node *n);                 // n, with children done
+  void simplifyConcat(Node *n);           // Flatten, drop "", merge literals
+  void simplifyAlternate(Node *n);        // Flatten, factor, fold classes
+  void simplifyRepeat(Node *n);           // Trivial and nested counts
+  std::vector<Node *> factorPrefixes(Node *n,
+                                     const std::vector<Node *> &kids);
+  std::vector<Node *> foldClasses(const std::vector<Node *> &kids);
+  Node *stripPrefix(Node *branch, size_t len); // Drop len leading bytes
+  static bool leadingLiteral(const Node *n, std::string_view *lit);
+  static void setChildren(Node *n, const std::vector<Node *> &kids);
+  static void replaceWith(Node *n, const Node *by); // Keep n's sibling link
+
+public:
+  explicit AstOptimizer(NFABuilder &builder);
+
+  Node *optimize(Node *root); // Rewrites in place, returns the root
+};
+
+/**
+ * @brief Lazily constructed DFA for capture-free matching
+ * @details
+ * DFA states are built on demand by subset construction over the NFA and
+ * cached together with their per-byte transitions, so once the cache is
+ * warm each input byte costs a single table lookup. A DFA state holds the
+ * threads the last byte led into, before their ε-closure; the closure is
+ * walked when the next byte (or the end of the input) is known, so every
+ * assertion is decided on the spot and the threads come out in the Pike
+ * VM's priority order. When the cache outgrows its budget it is flushed
+ * and rebuilt from the current state.
+ *
+ * With allMatches set, each DFA state also remembers which pattern ids
+ * reached STATE_MATCH just before the byte that led into it, so matchAll()
+ * can report every pattern of a set that matches anywhere in one scan.
+ *
+ * With firstMatch set, a match also drops every lower-priority thread
+ * behind it, as NFASimulator::step does, so the last match end findEnd()
+ * sees is the end of the leftmost-first match. findStart() runs on a
+ * reversed program (Prog::reverse, allMatches set) from that end back
+ * towards the start, and the furthest match is where the match starts.
+ */
+class LazyDFA {
+public:
+  /** @brief Content of a DFA state: (flags, insts, matched ids) */
+  typedef std::tuple<ut32, std::vector<ut32>, std::vector<ut32>> StateKey;
+
+  /** @brief States and first match ends recorded by trace() */
+  struct ScanTrace {
+    std::vector<StateKey> keys; // State every `every` bytes and at the end
+    std::vector<size_t> first;  // First match end per stretch (npos = none)
+  };
+
+private:
+  static constexpr st32 kUnknown = -2; // Transition not computed yet
+  static constexpr st32 kDead = -1;    // No NFA state survives
+  static constexpr st32 kEndOfText = 256; // Pseudo-byte for end of input
+  static constexpr st32 kStride = 257;    // Transition row width
+
+  enum : ut32 {
+    FLAG_START = 1u << 0, // At position 0 (^ holds)
+    FLAG_WORD = 1u << 1   // Previous byte was a word character
+  };
+
+  struct DState {
+    std::vector<ut32> insts;   // Entry thread ids, by priority
+    ut32 flags;                // FLAG_* context bits
+    std::vector<ut32> matched; // Pattern ids matched before the last byte
+    std::vector<ut32> end_ids; // Pattern ids matching at end of input
+    st8 accepts = -1;          // Match at end of input (-1 = unknown)
+  };
+
+  std::shared_ptr<const Prog> prog_;    // Compiled program
+  std::vector<DState> dstates_;         // Cached DFA states
+  std::map<StateKey, st32> cache_; // Content -> DState
+  std::vector<st32> trans_;   // dstates_.size() x kStride table
+  std::vector<st32> marks_;   // Per-instruction visit generation
+  std::vector<ut32> stack_;   // Closure work stack
+  st32 mark_gen_ = 0;         // Current visit generation
+  // Start states: anchored, then unanchored, each by FLAG_* context
+  st32 start_[2][4] = {{kUnknown, kUnknown, kUnknown, kUnknown},
+                       {kUnknown, kUnknown, kUnknown, kUnknown}};
+  size_t max_states_;         // Cache budget in DFA states
+  bool all_matches_;          // Track every pattern id (RegexSet)
+  bool first_match_;          // Cut threads below a match (findEnd)
+
+  void resolve(std::vector<ut32> &out, const std::vector<ut32> &in,
+               ut32 flags, st32 next); // Closure of a state's entries
+  void expand(std::vector<ut32> &out, ut32 pc, ut32 flags,
+              st32 next); // Closure with assertions decided
+  st32 intern(std::vector<ut32> &&insts, ut32 flags,
+              std::vector<ut32> &&matched); // Find/add DState
+  st32 startState(bool anchored,
+                  ut32 flags = FLAG_START); // Build a start state once
+  static ut32 flagsAfter(st32 byte); // Context after byte (-1: none)
+  st32 computeNext(st32 d, st32 byte); // Fill one transition
+  bool acceptsAtEnd(st32 d);           // End-of-input check
+  st32 flush(st32 keep); // Drop the cache, keeping one state
+  st32 step(st32 d, st32 byte); // Cached or computed transition
+
+  friend class StreamMatcher;
+
+public:
+  LazyDFA(std::shared_ptr<const Prog> prog, size_t maxStates = 4096,
+          bool allMatches = false, bool firstMatch = false);
+
+  bool match(std::string_view s); // Full match, same as NFASimulator
+  bool matchAll(std::string_view s, bool anchored,
+                MatchSet *out); // Every pattern id of a set that matches
+  size_t findEnd(std::string_view s,
+                 size_t from); // Leftmost-first match end, or npos
+  size_t findStart(std::string_view s, size_t end,
+                   size_t from); // Earliest start >= from, or npos
+  StateKey startKey(bool anchored); // Content of a start state
+  void trace(std::string_view s, const StateKey &entry, size_t every,
+             bool atEnd, ScanTrace *out); // Run from entry, record states
+  size_t state_count() const;   // Number of cached DFA states
+};
+
+/**
+ * @brief Parallel scan of one large buffer with a capture-free DFA
+ * @details
+ * The buffer is cut into chunks that are scanned concurrently, each by
+ * its own LazyDFA. A chunk cannot know the state it starts in, so it
+ * speculates: the DFA is run over the `lookback` bytes before the chunk,
+ * from the unanchored start, and the chunk starts in the state reached.
+ * Because of the leading .*? loop this is nearly always the real state.
+ * While scanning, each chunk records its state content every few
+ * kilobytes. A serial pass then chains the chunks in order. Where a
+ * guess was wrong, the chunk is re-run from the real state only until
+ * that run reaches one of the recorded states; from there the speculative
+ * results are valid again. DFA states are compared by content, so
+ * separate caches can be mixed freely.
+ */
+class ParallelScan {
+private:
+  std::shared_ptr<const Prog> prog_; // Compiled program
+  size_t min_chunk_;                 // Smallest chunk worth a task
+  size_t lookback_;                  // Bytes used to guess a chunk's state
+
+public:
+  ParallelScan(std::shared_ptr<const Prog> prog,
+               size_t minChunk = 1 << 16, size_t lookback = 256);
+
+  bool find(std::string_view s, size_t *end,
+            WorkPool *pool = nullptr) const; // Earliest match end anywhere
+};
+
+/**
+ * @brief Backtracking matcher that never visits a state twice
+ * @details
+ * A depth-first walk of the Prog that takes the preferred side of every
+ * choice first, as a STATE_SPLIT's greedy flag and a STATE_REPEAT's
+ * consume-before-exit order say, so the first match it reaches is the
+ * one the Pike VM would report. Capture slots live in one array and are
+ * restored on the way back. A bit per (thread id, offset) remembers
+ * what has been tried: whatever failed once fails again, whichever path
+ * got there, so the work stays within ids() times the input length.
+ *
+ * The bitset has one bit per pair, so only inputs with fits() true are
+ * taken; its budget is set at construction.
+ */
+class Backtracker {
+public:
+  static constexpr size_t kDefaultBudget = 256 << 10; // Visited bits
+
+private:
+  static constexpr ut32 kExplore = UT32_MAX; // Job enters id at pos
+
+  struct Job {
+    ut32 id;   // Thread id to enter
+    ut32 slot; // Slot to restore, or kExplore
+    st64 pos;  // Offset entered, or the slot's old value
+  };
+
+  std::shared_ptr<const Prog> prog_; // Compiled program
+  size_t budget_;                    // Largest bitset, in bits
+  std::vector<ut64> visited_;        // Bit id * stride + pos - base
+  std::vector<Job> stack_;           // Choices not taken yet
+  std::vector<st64> slots_;          // Capture slots of the current path
+  size_t base_ = 0;                  // First offset the bitset covers
+  size_t stride_ = 0;                // Offsets covered
+
+  bool run(std::string_view s, size_t at, bool full,
+           st64 *out); // Walk from start at offset at
+
+public:
+  Backtracker(std::shared_ptr<const Prog> prog,
+              size_t budget = kDefaultBudget);
+
+  bool fits(size_t length) const; // Bitset for length bytes in budget
+  ut32 width() const;             // Slots match() and search() fill
+  bool match(std::string_view s, st64 *out); // Full match
+  bool search(std::string_view s, size_t from,
+              st64 *out); // Leftmost match starting at or after from
 };
 
 /**
  * @brief NFA simulation engine for pattern matching
+ * @details
+ * Capture-free patterns are delegated to a LazyDFA. Everything else runs
+ * on a Pike VM: thread lists are sparse sets keyed by instruction, and
+ * each thread refers to an array of integer capture slots in a
+ * preallocated, reference-counted slab. Slot arrays are shared between
+ * threads and only copied when a capture instruction writes to them.
+ * Captured text is cut from the input on demand in get_capture, so the
+ * matched string must outlive those calls. Slot pair num_captures holds
+ * the overall match span. One-pass patterns skip the thread lists and
+ * run on the program's OnePass table; other inputs short enough for the
+ * Backtracker's bitset are matched by it. find() needs no captures at
+ * all: a DFA finds where the match ends, and a DFA over Prog::reverse
+ * reads back from there to where it starts. set_fast_paths(false) sends
+ * every call to the Pike VM, which the regression driver compares the
+ * other engines against.
  */
 class NFASimulator {
 private:
-  struct ListItem {
-    State *state; // Non-owning pointer to state
-    std::vector<CaptureGroup> caps;
+  static constexpr ut32 kNoSlots = UT32_MAX; // Thread without slots
+  static constexpr ut32 kRelease = UT32_MAX - 1; // Frame drops its slots
+
+  struct Thread {
+    ut32 pc;    // Thread id: instruction or repeat count (Prog::pcOf)
+    ut32 slots; // Slot array handle, kNoSlots for ε instructions
   };
 
-  struct List {
-    std::vector<ListItem> items;
+  static constexpr st32 kNoByte = -1; // Edge side outside the input
+  static constexpr size_t kOnePassBudget = 8; // OnePass bytes per input byte
+
+  // The bytes before and after a position, which is all the assertions
+  // look at; lets a stream decide them without the whole input at hand.
+  struct Edge {
+    st32 prev; // Byte before the position, kNoByte at the start
+    st32 next; // Byte at the position, kNoByte at the end
+  };
+
+  struct ThreadList {
+    std::vector<ut32> sparse;  // Thread id -> index into dense
+    std::vector<Thread> dense; // Threads in priority order
+    ut32 size = 0;             // Live entries in dense
+
+    void init(ut32 n);           // Size for n thread ids
+    bool contains(ut32 pc) const; // Membership test
+    Thread &insert(ut32 pc);     // Append pc (must be absent)
     void clear();
   };
 
-  State *start_;                       // Start state (non-owning)
-  State *matchstate_;                  // Match state (non-owning)
-  st32 listid_ = 0;                    // Generation counter
-  List l1_, l2_;                       // Current and next state lists
-  st32 num_capture_groups_;            // Number of capture groups
-  std::vector<CaptureGroup> captures_; // Storage for captures
+  struct Frame {
+    ut32 pc;    // Thread id to enter, or kRelease
+    ut32 slots; // Slot array the instruction sees
+  };
+
+  struct SlotSlab {
+    ut32 width = 0;               // Slots per array (2 per group)
+    std::vector<st64> slots;      // width slots per handle
+    std::vector<ut32> refs;       // Reference count per handle
+    std::vector<ut32> free_list;  // Released handles
+
+    void init(ut32 w, ut32 reserve); // Set width, preallocate arrays
+    ut32 alloc();                    // Fresh array, refcount 1
+    ut32 copy(ut32 h);               // Private copy of h, refcount 1
+    void incref(ut32 h);
+    void decref(ut32 h);
+    st64 *get(ut32 h);               // Valid until the next alloc/copy
+  };
+
+  std::shared_ptr<const Prog> prog_; // Compiled program
+  ThreadList l1_, l2_;               // Current and next thread lists
+  SlotSlab slab_;                    // Capture slot storage
+  std::vector<Frame> stack_;         // ε-closure work stack
+  std::vector<st64> match_slots_;    // Slots of the last match
+  std::string_view input_;           // Last input, for get_capture
+  std::unique_ptr<LazyDFA> dfa_;     // Set when there are no captures
+  std::unique_ptr<LazyDFA> end_dfa_;   // Leftmost-first ends (find)
+  std::unique_ptr<LazyDFA> start_dfa_; // Prog::reverse (find)
+  std::vector<st64> pass_slots_;     // OnePass working slots
+  Backtracker backtrack_;            // Engine for short inputs
+  bool fast_ = true;                 // Try the engines above the Pike VM
+
+  void addThread(ThreadList *l, ut32 pc, ut32 slots, Edge edge,
+                 st64 pos); // Follow ε-closure (iterative)
+  static Edge edgeAt(std::string_view input,
+                     st64 pos); // Bytes around position pos
+  static bool checkAssertion(const Inst &inst,
+                             Edge edge); // Check assertion between bytes
+  bool step(ThreadList *clist, ThreadList *nlist, std::string_view input,
+            st64 pos, bool stopAtMatch); // Consume input[pos]
+  bool finish(ThreadList *clist, st64 pos); // Pick a match at the end
+  void recordMatch(ut32 slots, st64 pos);  // Save slots of a match
+  void seed(ThreadList *l, ut32 pc, Edge edge,
+            st64 pos); // Start a thread with empty slots
+  void collect(const ThreadList *l, MatchSet *out) const; // Matched ids
+  void release(ThreadList *l);     // Drop slot references and clear
+  bool onePassSearch(std::string_view s,
+                     size_t *from); // Search on OnePass, within a budget
 
-  void addState(List *l, State *s, const std::string &input, st32 pos,
-                std::vector<CaptureGroup> caps); // Add state to list
-  bool checkAssertion(State *s, const std::string &input,
-                      st32 pos); // Check assertion at position
-  bool isWordBoundary(const std::string &input,
-                      st32 pos); // Check word boundary
-  List *startList(State *s, List *l, st32 pos); // Initialize state list
-  void step(List *clist, const std::string &input, st32 pos,
-            List *nlist); // Execute simulation step
-  bool isMatch(List *l, const std::string &input,
-               st32 pos); // Check for match state
+  friend class StreamMatcher;
 
 public:
-  NFASimulator(State *start, State *match, st32 numCaptures);
+  NFASimulator(std::shared_ptr<const Prog> prog);
+  NFASimulator(State *start, State *match, st32 numCaptures,
+               const std::vector<CharClass> &classes);
 
-  bool match(const std::string &s);         // Match string against NFA
+  bool match(std::string_view s);            // Match string against NFA
+  bool search(std::string_view s,
+              size_t from = 0); // Leftmost match starting at or after from
+  bool find(std::string_view s,
+            size_t from = 0); // Span of the same match, captures unset
+  bool matchAll(std::string_view s, bool anchored,
+                MatchSet *out); // Every pattern id of a set that matches
+  MatchSpan get_match_span() const;          // Span of the last match
   std::string get_capture(st32 index) const; // Get captured text
+  MatchSpan get_capture_span(st32 index) const; // Offsets of a group
+  void set_backtrack_budget(size_t bits); // Backtracker bitset, 0 = off
+  void set_fast_paths(bool on); // Off: everything runs on the Pike VM
+};
+
+/**
+ * @brief Matcher fed one chunk of input at a time
+ * @details
+ * Runs the same Pike VM as NFASimulator::search (or match when anchored)
+ * but keeps its threads between feed() calls, so a match may straddle
+ * any number of chunk boundaries and the chunks need not outlive the
+ * call. Threads waiting on an ε-closure are only expanded once the next
+ * byte is known, which lets $ and \b be decided correctly at a chunk
+ * edge; finish() decides them against end of input. Capture positions
+ * are absolute offsets into the whole stream. Anchored patterns without
+ * captures run on a LazyDFA whose state is carried over instead.
+ */
+class StreamMatcher {
+private:
+  std::shared_ptr<const Prog> prog_;      // Compiled program
+  NFASimulator sim_;                      // Thread lists and slot slab
+  std::vector<NFASimulator::Thread> pending_; // Threads awaiting closure
+  st32 dstate_ = 0;                       // DFA state (use_dfa_ only)
+  ut64 pos_ = 0;                          // Bytes consumed so far
+  st32 prev_ = NFASimulator::kNoByte;     // Last byte consumed
+  bool anchored_;                         // Match the whole stream
+  bool use_dfa_;                          // Run on the simulator's LazyDFA
+  bool matched_ = false;                  // A match has been recorded
+  bool finished_ = false;                 // finish() was called
+
+  void consume(st32 byte); // Advance the Pike VM by one byte
+  void dropPending();      // Release slot references of pending_
+
+public:
+  explicit StreamMatcher(std::shared_ptr<const Prog> prog,
+                         bool anchored = false);
+
+  void reset();                   // Start a new stream
+  void feed(std::string_view chunk); // Consume the next chunk
+  bool finish();                  // End of stream; true on a match
+  ut64 offset() const;            // Bytes fed so far
+  MatchSpan get_match_span() const; // Span of the match (after finish)
+  MatchSpan get_capture_span(st32 index) const; // Absolute group span
+};
+
+/**
+ * @brief Many patterns compiled into one program
+ * @details
+ * Each postfix pattern is built and lowered on its own, then the programs
+ * are joined under a root split (see Prog::join), so one scan of the input
+ * reports every pattern that matches. Matching runs on a LazyDFA by
+ * default or on the Pike VM when useDfa is false. Captures are ignored.
+ */
+class RegexSet {
+private:
+  std::shared_ptr<const Prog> prog_; // Joined program
+  size_t size_;                      // Number of patterns
+  std::unique_ptr<LazyDFA> dfa_;     // DFA engine (useDfa)
+  std::unique_ptr<NFASimulator> nfa_; // Pike VM engine (!useDfa)
+
+public:
+  RegexSet(const std::vector<std::string> &postfixes, bool useDfa = true);
+
+  size_t size() const; // Number of patterns
+  bool match(std::string_view s,
+             MatchSet *out); // Patterns matching all of s
+  bool search(std::string_view s,
+              MatchSet *out); // Patterns matching anywhere in s
+};
+
+/**
+ * @brief Work-stealing thread pool for data-parallel loops
+ * @details
+ * parallelFor() splits [0, n) into one contiguous range per participant
+ * (the workers plus the calling thread). Each participant cuts chunks off
+ * the front of its own range, sized as a fraction of what is left, so
+ * chunks shrink towards the end. A participant whose range runs dry
+ * steals the upper half of another one's range. Uneven per-item costs
+ * therefore even out without a fixed grain size. Calls from different
+ * threads are serialized. fn must not call back into the same pool. The
+ * first exception thrown by fn is rethrown in the caller.
+ */
+class WorkPool {
+private:
+  struct alignas(64) Range {
+    std::mutex lock; // Guards begin/end
+    size_t begin = 0; // Next item to run
+    size_t end = 0;   // One past the last item
+  };
+
+  std::vector<std::thread> workers_;
+  std::unique_ptr<Range[]> ranges_;     // One per participant
+  size_t participants_;                 // workers_.size() + 1
+
+  std::mutex run_lock_;                 // One parallelFor at a time
+  std::mutex state_lock_;               // Guards the fields below
+  std::condition_variable wake_;        // New job or shutdown
+  std::condition_variable done_;        // Last participant finished
+  ut64 generation_ = 0;                 // Job counter
+  size_t active_ = 0;                   // Participants still running
+  bool stop_ = false;
+  const std::function<void(size_t, size_t)> *fn_ = nullptr; // Current body
+  std::exception_ptr error_;            // First exception of the job
+
+  void workerLoop(size_t slot);
+  void runSlot(size_t slot);            // Drain own range, then steal
+  bool nextChunk(size_t slot, size_t *begin, size_t *end);
+  bool steal(size_t slot);
+
+public:
+  explicit WorkPool(size_t threads = 0); // 0 = hardware concurrency
+  ~WorkPool();
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+
+  size_t size() const; // Participants, including the caller
+  void parallelFor(size_t n,
+                   const std::function<void(size_t, size_t)> &fn); // fn(b, e)
+  static WorkPool &shared(); // Process-wide pool
+};
+
+/**
+ * @brief Immutable compiled pattern that any number of threads can share
+ * @details
+ * A Regex only holds a shared, read-only Prog, so copies and concurrent
+ * calls are safe. Everything a match writes to (thread lists, visit
+ * marks, capture slots, DFA cache) lives in an NFASimulator used as
+ * scratch space. Each thread takes its scratch from a thread-local pool
+ * keyed by the regex id, so after the first call on a thread matching
+ * allocates nothing. Captures of the last call on the calling thread can
+ * be read through scratch(). find() and search_batch() only report spans
+ * and never track captures.
+ */
+class Regex {
+private:
+  std::shared_ptr<const Prog> prog_; // Compiled program (read-only)
+  ut64 id_;                          // Scratch pool key
+
+public:
+  explicit Regex(const std::string &postfix);
+  explicit Regex(std::shared_ptr<const Prog> prog);
+  static Regex parse(std::string_view pattern); // From infix syntax
+
+  const Prog &prog() const;       // Compiled program
+  ut64 id() const;                // Unique id of the compiled program
+  NFASimulator &scratch() const;  // Calling thread's scratch for this regex
+  bool match(std::string_view s) const; // Full match
+  bool search(std::string_view s, MatchSpan *span = nullptr,
+              size_t from = 0) const; // Leftmost match at or after from
+  bool find(std::string_view s, MatchSpan *span,
+            size_t from = 0) const; // Same span, captures not tracked
+  void match_batch(const std::string_view *inputs, size_t count,
+                   MatchSet *out,
+                   WorkPool *pool = nullptr) const; // Bit i: inputs[i] matches
+  void search_batch(const std::string_view *inputs, size_t count,
+                    MatchSpan *spans,
+                    WorkPool *pool = nullptr) const; // Leftmost span per input
+  std::unique_ptr<StreamMatcher>
+  stream(bool anchored = false) const; // Matcher for chunked input
+};
+
+/**
+ * @brief Thread-safe LRU cache from pattern text to compiled Regex
+ * @details
+ * A pattern seen before skips conversion, building and lowering, and every
+ * copy handed out shares one Regex id and so one scratch per thread. Each
+ * entry is charged the size of its Prog plus its key; once the total is
+ * over the budget the least recently used entries go. A miss compiles
+ * outside the lock, so a slow pattern never holds up other threads; when
+ * two threads miss on the same key the first insert wins. Patterns that
+ * fail to compile throw and leave nothing behind.
+ */
+class RegexCache {
+public:
+  enum : ut32 {
+    FLAG_POSTFIX = 1u << 0 // Pattern is builder postfix, not infix syntax
+  };
+
+  /** @brief Counters since construction or the last clear() */
+  struct Stats {
+    ut64 hits = 0;      // Lookups served from the cache
+    ut64 misses = 0;    // Lookups that compiled
+    ut64 evictions = 0; // Entries dropped for the budget
+    size_t entries = 0; // Entries held now
+    size_t bytes = 0;   // Memory charged to them
+  };
+
+private:
+  static constexpr size_t kDefaultBudget = 64 << 20; // 64 MiB
+
+  struct Entry {
+    std::string key; // Flags byte followed by the pattern
+    Regex regex;     // Compiled pattern
+    size_t bytes;    // Charge against the budget
+  };
+
+  mutable std::mutex mu_;
+  std::list<Entry> lru_; // Most recently used first
+  std::unordered_map<std::string_view, std::list<Entry>::iterator>
+      index_;            // Views of Entry::key, stable in the list
+  size_t budget_;        // Byte budget
+  Stats stats_;          // Counters; entries is filled in by stats()
+
+  void trim(); // Evict down to the budget (mu_ held)
+
+public:
+  explicit RegexCache(size_t budget = kDefaultBudget);
+  RegexCache(const RegexCache &) = delete;
+  RegexCache &operator=(const RegexCache &) = delete;
+
+  Regex get(std::string_view pattern, ut32 flags = 0); // Cached or compiled
+  void set_budget(size_t bytes); // New budget, evicting if needed
+  size_t budget() const;         // Byte budget
+  Stats stats() const;           // Snapshot of the counters
+  void clear();                  // Drop every entry and reset the counters
+  static RegexCache &shared();   // Process-wide cache
 };
 
 } // namespace PzRegex
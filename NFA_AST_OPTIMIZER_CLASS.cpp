@@ -0,0 +1,247 @@
+#include "NFA.hpp"
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::Node Node;
+typedef PzRegex::NodeType NodeType;
+typedef PzRegex::NFABuilder NFABuilder;
+typedef PzRegex::AstOptimizer AstOptimizer;
+
+// AstOptimizer implementation
+AstOptimizer::AstOptimizer(NFABuilder &builder) : b_(builder) {}
+
+// Post-order with an explicit stack. Rewrites that build new nodes push
+// them back as ready, so they are simplified before the node above them.
+Node *AstOptimizer::optimize(Node *root) {
+  todo_.clear();
+  todo_.push_back({root, false});
+  while (!todo_.empty()) {
+    Visit v = todo_.back();
+    todo_.pop_back();
+    if (v.ready) {
+      simplify(v.node);
+      continue;
+    }
+    todo_.push_back({v.node, true});
+    for (Node *c = v.node->child; c; c = c->next)
+      todo_.push_back({c, false});
+  }
+  return root;
+}
+
+void AstOptimizer::simplify(Node *n) {
+  switch (n->type) {
+  case NodeType::NODE_CONCAT:
+    simplifyConcat(n);
+    break;
+  case NodeType::NODE_ALTERNATE:
+    simplifyAlternate(n);
+    break;
+  case NodeType::NODE_REPEAT:
+    simplifyRepeat(n);
+    break;
+  default:
+    break;
+  }
+}
+
+// Nested concatenations are spliced in, empty items dropped, and each run
+// of literals is copied into one string.
+void AstOptimizer::simplifyConcat(Node *n) {
+  std::vector<Node *> kids;
+  for (Node *c = n->child; c; c = c->next) {
+    if (c->type == NodeType::NODE_CONCAT) {
+      for (Node *g = c->child; g; g = g->next)
+        kids.push_back(g);
+    } else if (c->type != NodeType::NODE_EMPTY) {
+      kids.push_back(c);
+    }
+  }
+
+  size_t out = 0;
+  for (size_t i = 0; i < kids.size();) {
+    size_t j = i + 1;
+    if (kids[i]->type == NodeType::NODE_LITERAL) {
+      while (j < kids.size() && kids[j]->type == NodeType::NODE_LITERAL)
+        j++;
+      if (j - i > 1) {
+        std::string run;
+        for (size_t k = i; k < j; k++)
+          run.append(kids[k]->text);
+        kids[i]->text = b_.arena_.copy(run);
+      }
+    }
+    kids[out++] = kids[i];
+    i = j;
+  }
+  kids.resize(out);
+
+  if (kids.empty()) {
+    n->type = NodeType::NODE_EMPTY;
+    n->child = nullptr;
+  } else if (kids.size() == 1) {
+    replaceWith(n, kids[0]);
+  } else {
+    setChildren(n, kids);
+  }
+}
+
+void AstOptimizer::simplifyAlternate(Node *n) {
+  std::vector<Node *> kids;
+  for (Node *c = n->child; c; c = c->next) {
+    if (c->type == NodeType::NODE_ALTERNATE) {
+      for (Node *g = c->child; g; g = g->next)
+        kids.push_back(g);
+    } else {
+      kids.push_back(c);
+    }
+  }
+
+  kids = factorPrefixes(n, kids);
+  if (n->type != NodeType::NODE_ALTERNATE)
+    return; // The whole alternation became prefix (rest|...)
+  kids = foldClasses(kids);
+  if (kids.size() == 1)
+    replaceWith(n, kids[0]);
+  else
+    setChildren(n, kids);
+}
+
+// Adjacent branches whose leading literals share a first byte become
+// prefix (?:rest|rest|...), with the longest prefix they all have. Only
+// neighbours are grouped, so the order branches are tried in is kept.
+std::vector<Node *> AstOptimizer::factorPrefixes(
+    Node *n, const std::vector<Node *> &kids) {
+  std::vector<Node *> out;
+  for (size_t i = 0; i < kids.size();) {
+    std::string_view lit, other;
+    size_t j = i + 1;
+    size_t common = 0;
+    if (leadingLiteral(kids[i], &lit)) {
+      common = lit.size();
+      while (j < kids.size() && leadingLiteral(kids[j], &other) &&
+             other[0] == lit[0]) {
+        size_t k = 1;
+        while (k < common && k < other.size() && other[k] == lit[k])
+          k++;
+        common = k;
+        j++;
+      }
+    }
+    if (j - i == 1) {
+      out.push_back(kids[i++]);
+      continue;
+    }
+
+    Node *rest = b_.newNode(NodeType::NODE_ALTERNATE);
+    std::vector<Node *> rests;
+    for (size_t k = i; k < j; k++)
+      rests.push_back(stripPrefix(kids[k], common));
+    setChildren(rest, rests);
+
+    // The whole alternation shares the prefix: n itself turns into the
+    // concatenation, so nothing above it holds a stale node.
+    Node *cat = i == 0 && j == kids.size()
+                    ? n
+                    : b_.newNode(NodeType::NODE_CONCAT);
+    Node *prefix = b_.newNode(NodeType::NODE_LITERAL);
+    prefix->text = lit.substr(0, common);
+    cat->type = NodeType::NODE_CONCAT;
+    setChildren(cat, {prefix, rest});
+    todo_.push_back({cat, true});
+    todo_.push_back({rest, true});
+    out.push_back(cat);
+    i = j;
+  }
+  return out;
+}
+
+// Runs of adjacent one-byte branches: a|b|[cd] is [a-d]
+std::vector<Node *> AstOptimizer::foldClasses(const std::vector<Node *> &kids) {
+  auto oneByte = [](const Node *c) {
+    return c->type == NodeType::NODE_CLASS ||
+           (c->type == NodeType::NODE_LITERAL && c->text.size() == 1);
+  };
+  std::vector<Node *> out;
+  for (size_t i = 0; i < kids.size();) {
+    size_t j = i + 1;
+    if (oneByte(kids[i]))
+      while (j < kids.size() && oneByte(kids[j]))
+        j++;
+    if (j - i == 1) {
+      out.push_back(kids[i++]);
+      continue;
+    }
+    Node *cls = b_.newNode(NodeType::NODE_CLASS);
+    for (size_t k = i; k < j; k++) {
+      if (kids[k]->type == NodeType::NODE_LITERAL) {
+        cls->cc.addChar(kids[k]->text[0]);
+      } else {
+        for (size_t w = 0; w < cls->cc.bits.size(); w++)
+          cls->cc.bits[w] |= kids[k]->cc.bits[w];
+      }
+    }
+    out.push_back(cls);
+    i = j;
+  }
+  return out;
+}
+
+// x{1} is x, x{0} and ""{n,m} are "", and x**, x++ and x?? (same
+// greediness) are x*, x+ and x?. Mixed pairs such as x?* stay: when x can
+// match "" the two loops settle empty iterations differently.
+void AstOptimizer::simplifyRepeat(Node *n) {
+  Node *c = n->child;
+  if (n->min == 1 && n->max == 1) {
+    replaceWith(n, c);
+    return;
+  }
+  if (n->max == 0 || c->type == NodeType::NODE_EMPTY) {
+    n->type = NodeType::NODE_EMPTY;
+    n->child = nullptr;
+    return;
+  }
+
+  bool simple = n->min <= 1 && (n->max == -1 || (n->min == 0 && n->max == 1));
+  if (simple && c->type == NodeType::NODE_REPEAT && c->greedy == n->greedy &&
+      c->min == n->min && c->max == n->max)
+    replaceWith(n, c);
+}
+
+// The literal a branch starts with, already merged to full length
+bool AstOptimizer::leadingLiteral(const Node *n, std::string_view *lit) {
+  if (n->type == NodeType::NODE_CONCAT)
+    n = n->child;
+  if (n->type != NodeType::NODE_LITERAL)
+    return false;
+  *lit = n->text;
+  return true;
+}
+
+Node *AstOptimizer::stripPrefix(Node *branch, size_t len) {
+  Node *lit =
+      branch->type == NodeType::NODE_CONCAT ? branch->child : branch;
+  if (lit->text.size() > len) {
+    lit->text = lit->text.substr(len);
+    return branch;
+  }
+  if (lit == branch) {
+    branch->type = NodeType::NODE_EMPTY;
+    return branch;
+  }
+  branch->child = lit->next;
+  if (!branch->child->next)
+    replaceWith(branch, branch->child);
+  return branch;
+}
+
+void AstOptimizer::setChildren(Node *n, const std::vector<Node *> &kids) {
+  n->child = kids.empty() ? nullptr : kids[0];
+  for (size_t i = 0; i < kids.size(); i++)
+    kids[i]->next = i + 1 < kids.size() ? kids[i + 1] : nullptr;
+}
+
+void AstOptimizer::replaceWith(Node *n, const Node *by) {
+  Node *next = n->next;
+  *n = *by;
+  n->next = next;
+}
@@ -0,0 +1,155 @@
+#include "NFA.hpp"
+
+typedef PzRegex::StateType StateType;
+typedef PzRegex::AssertionType AssertionType;
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::Prefilter Prefilter;
+typedef PzRegex::Backtracker Backtracker;
+
+static bool isWordByte(st32 b) {
+  return b >= 0 && b < 256 && (isalnum(b) || b == '_');
+}
+
+static bool holds(AssertionType a, st32 prev, st32 next) {
+  switch (a) {
+  case AssertionType::ASSERT_START_LINE:
+    return prev < 0;
+  case AssertionType::ASSERT_END_LINE:
+    return next < 0;
+  case AssertionType::ASSERT_WORD_BOUND:
+    return isWordByte(prev) != isWordByte(next);
+  default:
+    return true;
+  }
+}
+
+// Backtracker implementation
+Backtracker::Backtracker(std::shared_ptr<const Prog> prog, size_t budget)
+    : prog_(std::move(prog)), budget_(budget),
+      slots_(2 * prog_->num_captures + 2, -1) {}
+
+bool Backtracker::fits(size_t length) const {
+  return prog_->match != Prog::kNone &&
+         (length + 1) <= budget_ / std::max<size_t>(prog_->ids(), 1);
+}
+
+ut32 Backtracker::width() const { return static_cast<ut32>(slots_.size()); }
+
+bool Backtracker::match(std::string_view s, st64 *out) {
+  base_ = 0;
+  stride_ = s.length() + 1;
+  visited_.assign((prog_->ids() * stride_ + 63) / 64, 0);
+  return run(s, 0, true, out);
+}
+
+// One bitset serves every start: a state that failed from an earlier
+// start fails the same way from a later one.
+bool Backtracker::search(std::string_view s, size_t from, st64 *out) {
+  if (from > s.length())
+    return false;
+  base_ = from;
+  stride_ = s.length() - from + 1;
+  visited_.assign((prog_->ids() * stride_ + 63) / 64, 0);
+
+  const Prefilter &pf = prog_->prefilter;
+  size_t at = pf.empty() ? from : pf.find(s, from);
+  while (at != Prefilter::npos && at <= s.length()) {
+    if (run(s, at, false, out))
+      return true;
+    at = pf.empty() ? at + 1 : pf.find(s, at + 1);
+  }
+  return false;
+}
+
+// The preferred side of each choice is followed at once and the other
+// pushed, so jobs pop in priority order. A capture pushes the old value of
+// its slot first, which puts it back once everything after it has failed.
+bool Backtracker::run(std::string_view s, size_t at, bool full, st64 *out) {
+  std::fill(slots_.begin(), slots_.end(), -1);
+  slots_[slots_.size() - 2] = static_cast<st64>(at);
+  stack_.clear();
+  stack_.push_back({prog_->start, kExplore, static_cast<st64>(at)});
+
+  while (!stack_.empty()) {
+    Job job = stack_.back();
+    stack_.pop_back();
+    if (job.slot != kExplore) {
+      slots_[job.slot] = job.pos;
+      continue;
+    }
+
+    ut32 id = job.id;
+    size_t pos = static_cast<size_t>(job.pos);
+    while (id != Prog::kNone) {
+      size_t bit = id * stride_ + pos - base_;
+      if ((visited_[bit >> 6] >> (bit & 63)) & 1)
+        break;
+      visited_[bit >> 6] |= 1ULL << (bit & 63);
+
+      st32 prev = pos > 0 ? static_cast<ut8>(s[pos - 1]) : -1;
+      st32 next = pos < s.length() ? static_cast<ut8>(s[pos]) : -1;
+      ut32 count;
+      const Inst &inst = prog_->insts[prog_->pcOf(id, &count)];
+      switch (inst.type()) {
+      case StateType::STATE_CHAR:
+        id = next == inst.arg ? inst.out : Prog::kNone;
+        pos++;
+        break;
+      case StateType::STATE_CHARCLASS:
+        id = next >= 0 &&
+                     prog_->classes[inst.arg].matches(static_cast<char>(next))
+                 ? inst.out
+                 : Prog::kNone;
+        pos++;
+        break;
+      case StateType::STATE_SPLIT:
+        stack_.push_back({inst.greedy ? inst.out1 : inst.out, kExplore,
+                          static_cast<st64>(pos)});
+        id = inst.greedy ? inst.out : inst.out1;
+        break;
+      case StateType::STATE_ASSERTION:
+        id = holds(static_cast<AssertionType>(inst.arg), prev, next)
+                 ? inst.out
+                 : Prog::kNone;
+        break;
+      case StateType::STATE_CAPTURE_START:
+      case StateType::STATE_CAPTURE_END:
+        if (inst.arg >= 0 && inst.arg < prog_->num_captures) {
+          bool end = inst.type() == StateType::STATE_CAPTURE_END;
+          ut32 slot = static_cast<ut32>(2 * inst.arg + (end ? 1 : 0));
+          stack_.push_back({0, slot, slots_[slot]});
+          slots_[slot] = static_cast<st64>(pos);
+        }
+        id = inst.out;
+        break;
+      case StateType::STATE_REPEAT: {
+        const Prog::Repeat &r = prog_->repeats[inst.arg];
+        bool exit = count >= r.min;
+        if (count < r.max && next >= 0 &&
+            prog_->classes[r.cls].matches(static_cast<char>(next))) {
+          if (exit)
+            stack_.push_back({inst.out, kExplore, static_cast<st64>(pos)});
+          id = prog_->advance(id);
+          pos++;
+        } else {
+          id = exit ? inst.out : Prog::kNone;
+        }
+        break;
+      }
+      case StateType::STATE_MATCH:
+        if (full && pos != s.length()) {
+          id = Prog::kNone;
+          break;
+        }
+        std::copy(slots_.begin(), slots_.end(), out);
+        out[slots_.size() - 1] = static_cast<st64>(pos);
+        return true;
+      default:
+        id = Prog::kNone;
+        break;
+      }
+    }
+  }
+  return false;
+}
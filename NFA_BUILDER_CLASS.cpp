@@ -1,362 +1,569 @@
-#include "NFA.hpp"
-
-typedef PzRegex::CharClass CharClass;
-typedef PzRegex::State State;
-typedef PzRegex::PtrList PtrList;
-typedef PzRegex::Frag Frag;
-typedef PzRegex::NFABuilder NFABuilder;
-typedef PzRegex::StateType StateType;
-typedef PzRegex::AssertionType AssertionType;
-
-// CharClass implementation
-void CharClass::addRange(char start, char end) {
-  for (char c = start; c <= end; c++) {
-    chars.insert(c);
-  }
-}
-
-void CharClass::addChar(char c) { chars.insert(c); }
-
-bool CharClass::matches(char c) const {
-  bool in_set = chars.find(c) != chars.end();
-  return negated ? !in_set : in_set;
-}
-
-// State implementation
-State::State(StateType t, st32 ch, State *o, State *o1)
-    : type(t), c(ch), out(o), out1(o1) {}
-
-State::State(st32 t, State *o, State *o1)
-    : type(static_cast<StateType>(t)), c(0), out(o), out1(o1) {}
-
-// PtrList implementation
-PtrList::PtrList(State **ptr, std::unique_ptr<PtrList> n)
-    : p(ptr), next(std::move(n)) {}
-
-// Frag implementation
-Frag::Frag(std::unique_ptr<State> s, std::unique_ptr<PtrList> o)
-    : start(std::move(s)), out(std::move(o)) {}
-
-// NFABuilder implementation
-NFABuilder::NFABuilder() {
-  matchstate_ = new State(StateType::STATE_MATCH);
-}
-
-void NFABuilder::patch(PtrList *l, State *s) {
-  for (; l; l = l->next.get()) {
-    *(l->p) = s;
-  }
-}
-
-std::unique_ptr<PtrList> NFABuilder::append(std::unique_ptr<PtrList> l1,
-                                             std::unique_ptr<PtrList> l2) {
-  if (!l1)
-    return l2;
-  PtrList *p = l1.get();
-  while (p->next)
-    p = p->next.get();
-  p->next = std::move(l2);
-  return l1;
-}
-
-std::unique_ptr<State> NFABuilder::build(const std::string &postfix) {
-  Frag stack[1000], *stackp = stack;
-
-  for (size_t i = 0; i < postfix.length(); i++) {
-    char ch = postfix[i];
-
-    switch (ch) {
-    case '.': { // Concatenation
-      Frag e2 = std::move(*--stackp);
-      Frag e1 = std::move(*--stackp);
-      patch(e1.out.get(), e2.start.get());
-      *stackp++ = Frag(std::move(e1.start), std::move(e2.out));
-      break;
-    }
-    case '|': { // Alternation
-      Frag e2 = std::move(*--stackp);
-      Frag e1 = std::move(*--stackp);
-      auto s = std::make_unique<State>(StateType::STATE_SPLIT, 0, e1.start.get(),
-                                       e2.start.get());
-      auto out_list = append(std::move(e1.out), std::move(e2.out));
-      e1.start.release();
-      e2.start.release();
-      *stackp++ = Frag(std::move(s), std::move(out_list));
-      break;
-    }
-    case '?': { // Zero or one (greedy)
-      Frag e1 = std::move(*--stackp);
-      auto s = std::make_unique<State>(StateType::STATE_SPLIT, 0,
-                                       e1.start.get(), nullptr);
-      s->greedy = true;
-      auto out_list = append(std::move(e1.out),
-                             std::make_unique<PtrList>(&s->out1));
-      e1.start.release();
-      *stackp++ = Frag(std::move(s), std::move(out_list));
-      break;
-    }
-    case '~': { // Non-greedy zero or one (??)
-      Frag e1 = std::move(*--stackp);
-      auto s = std::make_unique<State>(StateType::STATE_SPLIT, 0, nullptr,
-                                       e1.start.get());
-      s->greedy = false;
-      auto out_list = append(std::move(e1.out),
-                             std::make_unique<PtrList>(&s->out));
-      e1.start.release();
-      *stackp++ = Frag(std::move(s), std::move(out_list));
-      break;
-    }
-    case '*': { // Zero or more (greedy)
-      Frag e = std::move(*--stackp);
-      auto s = std::make_unique<State>(StateType::STATE_SPLIT, 0,
-                                       e.start.get(), nullptr);
-      s->greedy = true;
-      patch(e.out.get(), s.get());
-      auto out_list = std::make_unique<PtrList>(&s->out1);
-      e.start.release();
-      *stackp++ = Frag(std::move(s), std::move(out_list));
-      break;
-    }
-    case '@': { // Non-greedy zero or more (*?)
-      Frag e = std::move(*--stackp);
-      auto s = std::make_unique<State>(StateType::STATE_SPLIT, 0, nullptr,
-                                       e.start.get());
-      s->greedy = false;
-      patch(e.out.get(), s.get());
-      auto out_list = std::make_unique<PtrList>(&s->out);
-      e.start.release();
-      *stackp++ = Frag(std::move(s), std::move(out_list));
-      break;
-    }
-    case '+': { // One or more (greedy)
-      Frag e = std::move(*--stackp);
-      auto s = std::make_unique<State>(StateType::STATE_SPLIT, 0,
-                                       e.start.get(), nullptr);
-      s->greedy = true;
-      State *s_ptr = s.get();
-      patch(e.out.get(), s_ptr);
-      auto out_list = std::make_unique<PtrList>(&s->out1);
-      auto start = std::move(e.start);
-      s.release();
-      *stackp++ = Frag(std::move(start), std::move(out_list));
-      break;
-    }
-    case '#': { // Quantifier {n,m}
-      size_t j = i + 1;
-      st32 min = 0, max = 0;
-      std::string num;
-      while (j < postfix.size() && isdigit(static_cast<ut8>(postfix[j])))
-        num.push_back(postfix[j++]);
-      if (!num.empty())
-        min = std::stoi(num);
-      if (j < postfix.size() && postfix[j] == '-') {
-        ++j;
-        std::string maxnum;
-        while (j < postfix.size() && isdigit(static_cast<ut8>(postfix[j])))
-          maxnum.push_back(postfix[j++]);
-        if (!maxnum.empty())
-          max = std::stoi(maxnum);
-        else
-          max = -1; // open upper bound
-      } else {
-        max = min; // exact N
-      }
-
-      Frag e = std::move(*--stackp);
-      Frag result;
-
-      // Clone helper function
-      auto cloneFrag = [&](Frag &f) -> Frag {
-        if (!f.start)
-          return Frag(nullptr, nullptr);
-        std::unordered_map<State *, std::unique_ptr<State>> mp;
-        std::vector<State *> st;
-        st.push_back(f.start.get());
-
-        // Clone states
-        while (!st.empty()) {
-          State *old = st.back();
-          st.pop_back();
-          if (!old || mp.count(old))
-            continue;
-          mp[old] = std::make_unique<State>(old->type, old->c);
-          mp[old]->greedy = old->greedy;
-          mp[old]->assertion = old->assertion;
-          mp[old]->captureIndex = old->captureIndex;
-          if (old->charClass) {
-            mp[old]->charClass = std::make_unique<CharClass>(*old->charClass);
-          }
-          if (old->out && !mp.count(old->out))
-            st.push_back(old->out);
-          if (old->out1 && !mp.count(old->out1))
-            st.push_back(old->out1);
-        }
-
-        // Wire cloned nodes
-        for (auto &kv : mp) {
-          State *old = kv.first;
-          State *nw = kv.second.get();
-          nw->out = (old->out && mp.count(old->out)) ? mp[old->out].get() : old->out;
-          nw->out1 = (old->out1 && mp.count(old->out1)) ? mp[old->out1].get() : old->out1;
-        }
-
-        // Rebuild PtrList
-        std::unique_ptr<PtrList> newHead = nullptr;
-        std::unique_ptr<PtrList> *tail = &newHead;
-        for (PtrList *p = f.out.get(); p; p = p->next.get()) {
-          State **origPtr = p->p;
-          State **newPtr = origPtr;
-          for (auto &kv : mp) {
-            State *old = kv.first;
-            State *clone = kv.second.get();
-            if (origPtr == &old->out) {
-              newPtr = &clone->out;
-              break;
-            }
-            if (origPtr == &old->out1) {
-              newPtr = &clone->out1;
-              break;
-            }
-          }
-          auto node = std::make_unique<PtrList>(newPtr);
-          *tail = std::move(node);
-          tail = &(*tail)->next;
-        }
-
-        auto start_state = std::move(mp[f.start.get()]);
-        for (auto &kv : mp) {
-          if (kv.second.get() != start_state.get()) {
-            kv.second.release();
-          }
-        }
-        return Frag(std::move(start_state), std::move(newHead));
-      };
-
-      // Build min copies
-      if (min == 0) {
-        auto eps = std::make_unique<State>(StateType::STATE_SPLIT, 0);
-        auto out_list = std::make_unique<PtrList>(&eps->out,
-                         std::make_unique<PtrList>(&eps->out1));
-        result = Frag(std::move(eps), std::move(out_list));
-      } else {
-        result = cloneFrag(e);
-        for (st32 k = 1; k < min; ++k) {
-          Frag next = cloneFrag(e);
-          patch(result.out.get(), next.start.get());
-          result = Frag(std::move(result.start), std::move(next.out));
-        }
-      }
-
-      // Add optional copies
-      if (max == -1) {
-        Frag loop = cloneFrag(e);
-        auto split = std::make_unique<State>(StateType::STATE_SPLIT, 0,
-                                             loop.start.get(), nullptr);
-        State *split_ptr = split.get();
-        patch(result.out.get(), split_ptr);
-        patch(loop.out.get(), split_ptr);
-        auto out_list = std::make_unique<PtrList>(&split->out1);
-        loop.start.release();
-        result = Frag(std::move(result.start), std::move(out_list));
-        split.release();
-      } else {
-        std::unique_ptr<PtrList> tail = std::move(result.out);
-        for (st32 k = min; k < max; ++k) {
-          Frag opt = cloneFrag(e);
-          auto split = std::make_unique<State>(StateType::STATE_SPLIT, 0,
-                                               opt.start.get(), nullptr);
-          patch(tail.get(), split.get());
-          tail = append(std::move(opt.out),
-                       std::make_unique<PtrList>(&split->out1));
-          opt.start.release();
-          split.release();
-        }
-        result = Frag(std::move(result.start), std::move(tail));
-      }
-
-      *stackp++ = std::move(result);
-      i = j - 1;
-      break;
-    }
-    case '(': { // Start capture group
-      st32 capIndex = next_capture_index_++;
-      auto s = std::make_unique<State>(StateType::STATE_CAPTURE_START);
-      s->captureIndex = capIndex;
-      *stackp++ = Frag(std::move(s), std::make_unique<PtrList>(&(*(stackp-1)).start->out));
-      break;
-    }
-    case ')': { // End capture group
-      Frag e2 = std::move(*--stackp);
-      Frag e1 = std::move(*--stackp);
-      auto endCap = std::make_unique<State>(StateType::STATE_CAPTURE_END);
-      endCap->captureIndex = e1.start->captureIndex;
-
-      patch(e1.out.get(), e2.start.get());
-      patch(e2.out.get(), endCap.get());
-      auto out_list = std::make_unique<PtrList>(&endCap->out);
-      e2.start.release();
-      *stackp++ = Frag(std::move(e1.start), std::move(out_list));
-      endCap.release();
-      break;
-    }
-    case '^': { // Start of line
-      auto s = std::make_unique<State>(StateType::STATE_ASSERTION);
-      s->assertion = AssertionType::ASSERT_START_LINE;
-      *stackp++ = Frag(std::move(s), std::make_unique<PtrList>(&(*(stackp-1)).start->out));
-      break;
-    }
-    case '$': { // End of line
-      auto s = std::make_unique<State>(StateType::STATE_ASSERTION);
-      s->assertion = AssertionType::ASSERT_END_LINE;
-      *stackp++ = Frag(std::move(s), std::make_unique<PtrList>(&(*(stackp-1)).start->out));
-      break;
-    }
-    case 'B': { // Word boundary
-      auto s = std::make_unique<State>(StateType::STATE_ASSERTION);
-      s->assertion = AssertionType::ASSERT_WORD_BOUND;
-      *stackp++ = Frag(std::move(s), std::make_unique<PtrList>(&(*(stackp-1)).start->out));
-      break;
-    }
-    case '[': { // Character class
-      i++;
-      auto cc = std::make_unique<CharClass>();
-
-      if (i < postfix.length() && postfix[i] == '^') {
-        cc->negated = true;
-        i++;
-      }
-
-      while (i < postfix.length() && postfix[i] != ']') {
-        char start = postfix[i];
-        if (i + 2 < postfix.length() && postfix[i + 1] == '-' &&
-            postfix[i + 2] != ']') {
-          char end = postfix[i + 2];
-          cc->addRange(start, end);
-          i += 3;
-        } else {
-          cc->addChar(start);
-          i++;
-        }
-      }
-
-      auto s = std::make_unique<State>(StateType::STATE_CHARCLASS);
-      s->charClass = std::move(cc);
-      *stackp++ = Frag(std::move(s), std::make_unique<PtrList>(&(*(stackp-1)).start->out));
-      break;
-    }
-    default: { // Literal character
-      auto s = std::make_unique<State>(StateType::STATE_CHAR, static_cast<st32>(ch));
-      *stackp++ = Frag(std::move(s), std::make_unique<PtrList>(&(*(stackp-1)).start->out));
-      break;
-    }
-    }
-  }
-
-  Frag e = std::move(*--stackp);
-  patch(e.out.get(), matchstate_);
-  return std::move(e.start);
-}
-
-State *NFABuilder::get_match_state() const { return matchstate_; }
-
-st32 NFABuilder::get_capture_count() const { return next_capture_index_; }
\ No newline at end of file
+#include "NFA.hpp"
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::State State;
+typedef PzRegex::Hole Hole;
+typedef PzRegex::PatchList PatchList;
+typedef PzRegex::Frag Frag;
+typedef PzRegex::Node Node;
+typedef PzRegex::NodeType NodeType;
+typedef PzRegex::Arena Arena;
+typedef PzRegex::NFABuilder NFABuilder;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::AssertionType AssertionType;
+
+// CharClass implementation
+void CharClass::addRange(char start, char end) {
+  for (ut32 b = static_cast<ut8>(start); b <= static_cast<ut8>(end); b++) {
+    bits[b >> 6] |= 1ULL << (b & 63);
+  }
+}
+
+void CharClass::addChar(char c) { addRange(c, c); }
+
+void CharClass::negate() {
+  for (ut64 &w : bits)
+    w = ~w;
+}
+
+// State implementation
+State::State(StateType t, st32 ch, State *o, State *o1)
+    : type(t), c(ch), out(o), out1(o1) {}
+
+State::State(st32 t, State *o, State *o1)
+    : type(static_cast<StateType>(t)), c(0), out(o), out1(o1) {}
+
+// Hole implementation
+Hole::Hole(ut32 s) : slot(s) {}
+
+// Frag implementation
+Frag::Frag(State *s, PatchList o) : start(s), out(o) {}
+
+// Node implementation
+Node::Node(NodeType t) : type(t) {}
+
+// Arena implementation
+// Blocks double in size, so a graph of n nodes costs O(log n) blocks.
+void *Arena::allocate(size_t size, size_t align) {
+  size_t pad = (align - reinterpret_cast<uintptr_t>(next_) % align) % align;
+  if (pad + size > left_) {
+    size_t block = std::max(size + align, next_block_);
+    next_block_ = std::min<size_t>(2 * next_block_, kMaxBlock);
+    blocks_.emplace_back(new char[block]);
+    next_ = blocks_.back().get();
+    left_ = block;
+    used_ += block;
+    pad = (align - reinterpret_cast<uintptr_t>(next_) % align) % align;
+  }
+  void *p = next_ + pad;
+  next_ += pad + size;
+  left_ -= pad + size;
+  return p;
+}
+
+std::string_view Arena::copy(std::string_view s) {
+  char *p = static_cast<char *>(allocate(s.size(), 1));
+  std::memcpy(p, s.data(), s.size());
+  return std::string_view(p, s.size());
+}
+
+size_t Arena::bytes() const { return used_; }
+
+// NFABuilder implementation
+NFABuilder::NFABuilder() {
+  matchstate_ = newState(StateType::STATE_MATCH);
+}
+
+State *NFABuilder::newState(StateType t, st32 ch, State *o, State *o1) {
+  State *s = arena_.make<State>(t, ch, o, o1);
+  s->id = static_cast<ut32>(states_.size());
+  states_.push_back(s);
+  return s;
+}
+
+PatchList NFABuilder::hole(State *s, bool second) {
+  PatchList l;
+  l.head = l.tail = arena_.make<Hole>(2 * s->id + (second ? 1 : 0));
+  return l;
+}
+
+void NFABuilder::patch(PatchList l, State *s) {
+  for (Hole *h = l.head; h; h = h->next) {
+    State *owner = states_[h->slot >> 1];
+    (h->slot & 1 ? owner->out1 : owner->out) = s;
+  }
+}
+
+PatchList NFABuilder::append(PatchList l1, PatchList l2) {
+  if (!l1.head)
+    return l2;
+  if (!l2.head)
+    return l1;
+  l1.tail->next = l2.head;
+  l1.tail = l2.tail;
+  return l1;
+}
+
+// The fragment is unpatched, so everything reachable from its start
+// belongs to it and every edge leaving it is a hole. Copies are found by
+// state id, which also maps each hole straight to the copy's slot.
+Frag NFABuilder::cloneFrag(const Frag &f) {
+  if (!f.start)
+    return Frag();
+  clone_of_.resize(states_.size());
+  std::vector<State *> olds;
+  std::vector<State *> st;
+  st.push_back(f.start);
+
+  // Clone states
+  while (!st.empty()) {
+    State *old = st.back();
+    st.pop_back();
+    if (!old || clone_of_[old->id])
+      continue;
+    State *nw = newState(old->type, old->c);
+    nw->greedy = old->greedy;
+    nw->assertion = old->assertion;
+    nw->captureIndex = old->captureIndex;
+    nw->classIndex = old->classIndex;
+    nw->repeatMin = old->repeatMin;
+    nw->repeatMax = old->repeatMax;
+    clone_of_[old->id] = nw;
+    olds.push_back(old);
+    st.push_back(old->out);
+    st.push_back(old->out1);
+  }
+
+  // Wire cloned nodes
+  for (State *old : olds) {
+    State *nw = clone_of_[old->id];
+    nw->out = old->out ? clone_of_[old->out->id] : nullptr;
+    nw->out1 = old->out1 ? clone_of_[old->out1->id] : nullptr;
+  }
+
+  // Rebuild the hole list against the copies
+  PatchList out;
+  for (Hole *h = f.out.head; h; h = h->next)
+    out = append(out, hole(clone_of_[h->slot >> 1], h->slot & 1));
+
+  Frag copy(clone_of_[f.start->id], out);
+  for (State *old : olds)
+    clone_of_[old->id] = nullptr;
+  return copy;
+}
+
+// Fragment combinators, driven by lower()
+Frag NFABuilder::literal(char c) {
+  State *s = newState(StateType::STATE_CHAR, static_cast<st32>(c));
+  return Frag(s, hole(s, false));
+}
+
+Frag NFABuilder::charClass(const CharClass &cc) {
+  State *s = newState(StateType::STATE_CHARCLASS);
+  s->classIndex = internClass(cc);
+  return Frag(s, hole(s, false));
+}
+
+Frag NFABuilder::assertion(AssertionType a) {
+  State *s = newState(StateType::STATE_ASSERTION);
+  s->assertion = a;
+  return Frag(s, hole(s, false));
+}
+
+// A split whose both arms go on to the same successor
+Frag NFABuilder::empty() {
+  State *s = newState(StateType::STATE_SPLIT, 0);
+  return Frag(s, append(hole(s, false), hole(s, true)));
+}
+
+Frag NFABuilder::openCapture(st32 index) {
+  State *s = newState(StateType::STATE_CAPTURE_START);
+  s->captureIndex = index;
+  return Frag(s, hole(s, false));
+}
+
+Frag NFABuilder::closeCapture(Frag open, Frag body) {
+  State *endCap = newState(StateType::STATE_CAPTURE_END);
+  endCap->captureIndex = open.start->captureIndex;
+  patch(open.out, body.start);
+  patch(body.out, endCap);
+  return Frag(open.start, hole(endCap, false));
+}
+
+Frag NFABuilder::concat(Frag e1, Frag e2) {
+  patch(e1.out, e2.start);
+  return Frag(e1.start, e2.out);
+}
+
+Frag NFABuilder::alternate(Frag e1, Frag e2) {
+  State *s = newState(StateType::STATE_SPLIT, 0, e1.start, e2.start);
+  return Frag(s, append(e1.out, e2.out));
+}
+
+// x{min,max}, max < 0 for no upper bound. ?, * and + are the special
+// cases with one split; a lone byte or class is counted by one
+// STATE_REPEAT; anything else is copied min times plus max - min optional
+// copies. Counted forms are greedy only.
+Frag NFABuilder::repeat(Frag e, st32 min, st32 max, bool greedy) {
+  if (min == 0 && max == 1) {
+    State *s = newState(StateType::STATE_SPLIT, 0, e.start, nullptr);
+    s->greedy = greedy;
+    return Frag(s, append(e.out, hole(s, true)));
+  }
+  if (min <= 1 && max < 0) {
+    State *s = newState(StateType::STATE_SPLIT, 0, e.start, nullptr);
+    s->greedy = greedy;
+    patch(e.out, s);
+    return Frag(min == 0 ? s : e.start, hole(s, true));
+  }
+  if (min == 1 && max == 1)
+    return e;
+  if (max == 0)
+    return empty();
+
+  bool single = e.out.head == e.out.tail &&
+                e.out.head->slot == 2 * e.start->id &&
+                (e.start->type == StateType::STATE_CHAR ||
+                 e.start->type == StateType::STATE_CHARCLASS);
+  if (single) {
+    State *s = newState(StateType::STATE_REPEAT);
+    if (e.start->type == StateType::STATE_CHARCLASS) {
+      s->classIndex = e.start->classIndex;
+    } else {
+      CharClass cc;
+      cc.addChar(static_cast<char>(e.start->c));
+      s->classIndex = internClass(cc);
+    }
+    s->repeatMin = min;
+    s->repeatMax = max;
+    return Frag(s, hole(s, false));
+  }
+
+  // Build min copies
+  Frag result;
+  if (min == 0) {
+    result = empty();
+  } else {
+    result = cloneFrag(e);
+    for (st32 k = 1; k < min; ++k)
+      result = concat(result, cloneFrag(e));
+  }
+
+  // Add optional copies
+  if (max < 0) {
+    Frag loop = cloneFrag(e);
+    State *split = newState(StateType::STATE_SPLIT, 0, loop.start, nullptr);
+    patch(result.out, split);
+    patch(loop.out, split);
+    return Frag(result.start, hole(split, true));
+  }
+  PatchList tail = result.out;
+  for (st32 k = min; k < max; ++k) {
+    Frag opt = cloneFrag(e);
+    State *split = newState(StateType::STATE_SPLIT, 0, opt.start, nullptr);
+    patch(tail, split);
+    tail = append(opt.out, hole(split, true));
+  }
+  return Frag(result.start, tail);
+}
+
+State *NFABuilder::finish(Frag e) {
+  patch(e.out, matchstate_);
+  return e.start;
+}
+
+Node *NFABuilder::newNode(NodeType t) { return arena_.make<Node>(t); }
+
+// Postfix operators map one to one onto tree nodes; AstOptimizer flattens
+// the binary chains this leaves behind.
+Node *NFABuilder::fromPostfix(const std::string &postfix) {
+  std::vector<Node *> stack;
+  size_t i = 0;
+  auto pop = [&]() {
+    if (stack.empty())
+      PzError::report_error(PzError::PzErrorType::PZ_INVALID_INPUT,
+                            "postfix: missing operand at offset " +
+                                std::to_string(i));
+    Node *n = stack.back();
+    stack.pop_back();
+    return n;
+  };
+  auto node = [&](NodeType t, Node *child = nullptr) {
+    Node *n = newNode(t);
+    n->child = child;
+    return n;
+  };
+  auto pair = [&](NodeType t) {
+    Node *e2 = pop();
+    Node *e1 = pop();
+    e1->next = e2;
+    return node(t, e1);
+  };
+  auto rep = [&](st32 min, st32 max, bool greedy) {
+    Node *n = node(NodeType::NODE_REPEAT, pop());
+    n->min = min;
+    n->max = max;
+    n->greedy = greedy;
+    return n;
+  };
+  auto assert_node = [&](AssertionType a) {
+    Node *n = node(NodeType::NODE_ASSERTION);
+    n->assertion = a;
+    return n;
+  };
+
+  for (; i < postfix.length(); i++) {
+    char ch = postfix[i];
+
+    switch (ch) {
+    case '.': // Concatenation
+      stack.push_back(pair(NodeType::NODE_CONCAT));
+      break;
+    case '|': // Alternation
+      stack.push_back(pair(NodeType::NODE_ALTERNATE));
+      break;
+    case '?': // Zero or one (greedy)
+      stack.push_back(rep(0, 1, true));
+      break;
+    case '~': // Non-greedy zero or one (??)
+      stack.push_back(rep(0, 1, false));
+      break;
+    case '*': // Zero or more (greedy)
+      stack.push_back(rep(0, -1, true));
+      break;
+    case '@': // Non-greedy zero or more (*?)
+      stack.push_back(rep(0, -1, false));
+      break;
+    case '+': // One or more (greedy)
+      stack.push_back(rep(1, -1, true));
+      break;
+    case '%': // Non-greedy one or more (+?)
+      stack.push_back(rep(1, -1, false));
+      break;
+    case '#': { // Quantifier {n,m}
+      size_t j = i + 1;
+      st32 min = 0, max = 0;
+      std::string num;
+      while (j < postfix.size() && isdigit(static_cast<ut8>(postfix[j])))
+        num.push_back(postfix[j++]);
+      if (!num.empty())
+        min = std::stoi(num);
+      if (j < postfix.size() && postfix[j] == '-') {
+        ++j;
+        std::string maxnum;
+        while (j < postfix.size() && isdigit(static_cast<ut8>(postfix[j])))
+          maxnum.push_back(postfix[j++]);
+        if (!maxnum.empty())
+          max = std::stoi(maxnum);
+        else
+          max = -1; // open upper bound
+      } else {
+        max = min; // exact N
+      }
+
+      stack.push_back(rep(min, max, true));
+      i = j - 1;
+      break;
+    }
+    case '(': { // Start capture group
+      Node *open = node(NodeType::NODE_CAPTURE);
+      open->capture = next_capture_index_++;
+      stack.push_back(open);
+      break;
+    }
+    case ')': { // End capture group
+      Node *body = pop();
+      Node *open = pop();
+      if (open->type != NodeType::NODE_CAPTURE || open->child)
+        PzError::report_error(PzError::PzErrorType::PZ_INVALID_INPUT,
+                              "postfix: ) without ( at offset " +
+                                  std::to_string(i));
+      open->child = body;
+      stack.push_back(open);
+      break;
+    }
+    case '^': // Start of line
+      stack.push_back(assert_node(AssertionType::ASSERT_START_LINE));
+      break;
+    case '$': // End of line
+      stack.push_back(assert_node(AssertionType::ASSERT_END_LINE));
+      break;
+    case 'B': // Word boundary
+      stack.push_back(assert_node(AssertionType::ASSERT_WORD_BOUND));
+      break;
+    case '[': { // Character class
+      i++;
+      CharClass cc;
+      bool negated = false;
+
+      if (i < postfix.length() && postfix[i] == '^') {
+        negated = true;
+        i++;
+      }
+
+      // A backslash takes the next byte literally, so ], ^, - and \ can
+      // be class members too
+      while (i < postfix.length() && postfix[i] != ']') {
+        if (postfix[i] == '\\' && i + 1 < postfix.length())
+          i++;
+        char start = postfix[i];
+        if (i + 2 < postfix.length() && postfix[i + 1] == '-' &&
+            postfix[i + 2] != ']') {
+          i += 2;
+          if (postfix[i] == '\\' && i + 1 < postfix.length())
+            i++;
+          char end = postfix[i];
+          cc.addRange(start, end);
+          i++;
+        } else {
+          cc.addChar(start);
+          i++;
+        }
+      }
+
+      if (negated)
+        cc.negate();
+      Node *n = node(NodeType::NODE_CLASS);
+      n->cc = cc;
+      stack.push_back(n);
+      break;
+    }
+    default: { // Literal character
+      Node *n = node(NodeType::NODE_LITERAL);
+      n->text = arena_.copy(std::string_view(&ch, 1));
+      stack.push_back(n);
+      break;
+    }
+    }
+  }
+
+  return pop();
+}
+
+// Children are lowered first to last and left on frags, so a node finds
+// its own operands on top of the stack. No recursion: the depth of the
+// tree is bounded only by memory.
+Frag NFABuilder::lower(Node *root) {
+  std::vector<std::pair<Node *, bool>> todo;
+  std::vector<Frag> frags;
+  todo.push_back({root, false});
+  while (!todo.empty()) {
+    Node *n = todo.back().first;
+    bool ready = todo.back().second;
+    todo.pop_back();
+    if (!ready) {
+      todo.push_back({n, true});
+      size_t first = todo.size();
+      for (Node *c = n->child; c; c = c->next)
+        todo.push_back({c, false});
+      std::reverse(todo.begin() + first, todo.end());
+      continue;
+    }
+
+    size_t k = 0;
+    for (Node *c = n->child; c; c = c->next)
+      k++;
+    std::vector<Frag>::iterator kids = frags.end() - k;
+    Frag f;
+    switch (n->type) {
+    case NodeType::NODE_EMPTY:
+      f = empty();
+      break;
+    case NodeType::NODE_LITERAL:
+      f = literal(n->text[0]);
+      for (size_t j = 1; j < n->text.size(); j++)
+        f = concat(f, literal(n->text[j]));
+      break;
+    case NodeType::NODE_CLASS:
+      f = charClass(n->cc);
+      break;
+    case NodeType::NODE_ASSERTION:
+      f = assertion(n->assertion);
+      break;
+    case NodeType::NODE_CONCAT:
+      f = k == 0 ? empty() : kids[0];
+      for (size_t j = 1; j < k; j++)
+        f = concat(f, kids[j]);
+      break;
+    case NodeType::NODE_ALTERNATE:
+      f = k == 0 ? empty() : kids[0];
+      for (size_t j = 1; j < k; j++)
+        f = alternate(f, kids[j]);
+      break;
+    case NodeType::NODE_REPEAT:
+      f = repeat(kids[0], n->min, n->max, n->greedy);
+      break;
+    case NodeType::NODE_CAPTURE:
+      // A ( left open in postfix text is just the capture start
+      f = openCapture(n->capture);
+      if (k == 1)
+        f = closeCapture(f, kids[0]);
+      break;
+    }
+    frags.erase(kids, frags.end());
+    frags.push_back(f);
+  }
+  return frags.back();
+}
+
+// Every node is visited once, in any order: each one only rearranges
+// its own children or text.
+void NFABuilder::mirror(Node *root) {
+  std::vector<Node *> todo = {root};
+  while (!todo.empty()) {
+    Node *n = todo.back();
+    todo.pop_back();
+    if (n->type == NodeType::NODE_CONCAT) {
+      Node *prev = nullptr;
+      for (Node *c = n->child; c;) {
+        Node *next = c->next;
+        c->next = prev;
+        prev = c;
+        c = next;
+      }
+      n->child = prev;
+    } else if (n->type == NodeType::NODE_LITERAL) {
+      n->text = arena_.copy(std::string(n->text.rbegin(), n->text.rend()));
+    } else if (n->type == NodeType::NODE_ASSERTION) {
+      if (n->assertion == AssertionType::ASSERT_START_LINE)
+        n->assertion = AssertionType::ASSERT_END_LINE;
+      else if (n->assertion == AssertionType::ASSERT_END_LINE)
+        n->assertion = AssertionType::ASSERT_START_LINE;
+    }
+    for (Node *c = n->child; c; c = c->next)
+      todo.push_back(c);
+  }
+}
+
+State *NFABuilder::build(const std::string &postfix, bool reversed) {
+  Node *tree = PzRegex::AstOptimizer(*this).optimize(fromPostfix(postfix));
+  if (reversed)
+    mirror(tree);
+  return finish(lower(tree));
+}
+
+State *NFABuilder::parse(std::string_view pattern, bool reversed) {
+  PzRegex::InfixParser parser(*this, pattern);
+  Node *tree = PzRegex::AstOptimizer(*this).optimize(parser.parse());
+  if (reversed)
+    mirror(tree);
+  return finish(lower(tree));
+}
+
+State *NFABuilder::get_match_state() const { return matchstate_; }
+
+st32 NFABuilder::get_capture_count() const { return next_capture_index_; }
+
+const std::vector<CharClass> &NFABuilder::get_classes() const {
+  return classes_;
+}
+
+st32 NFABuilder::internClass(const CharClass &cc) {
+  auto it = class_ids_.find(cc.bits);
+  if (it != class_ids_.end())
+    return it->second;
+  st32 id = static_cast<st32>(classes_.size());
+  classes_.push_back(cc);
+  class_ids_.emplace(cc.bits, id);
+  return id;
+}
\ No newline at end of file
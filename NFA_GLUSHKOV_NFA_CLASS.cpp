@@ -0,0 +1,256 @@
+#include "NFA.hpp"
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::AssertionType AssertionType;
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::GlushkovNFA GlushkovNFA;
+using PzRegex::lowestBit;
+
+static bool isWordByte(st32 b) {
+  return b >= 0 && b < 256 && (isalnum(b) || b == '_');
+}
+
+static ut32 assertBit(AssertionType a) {
+  return 1u << static_cast<ut32>(a);
+}
+
+// GlushkovNFA implementation
+// Each position's edges are the ε-closure of what follows it, walked in
+// the order NFASimulator::addThread walks it. An instruction reached a
+// second time is skipped unless every earlier visit needed an assertion
+// this path does not, since at run time that earlier path may be the one
+// that fails. Positions are numbered as the closures first reach them.
+GlushkovNFA GlushkovNFA::fromProg(const Prog &prog) {
+  GlushkovNFA g;
+  if (prog.ids() > kMaxIds || 2 * (prog.num_captures + 1) > 64)
+    return g;
+
+  struct Frame {
+    ut32 id;      // Thread id to enter
+    ut32 asserts; // Conditions met on the way
+    ut64 slots;   // Capture slots set on the way
+  };
+  std::vector<ut32> position(prog.ids(), Prog::kNone); // Thread id -> position
+  std::vector<ut16> seen(prog.ids(), 0); // Bit m: visited under conditions m
+  std::vector<ut32> touched;
+  std::vector<Frame> stack;
+
+  auto enter = [&](ut32 id) {
+    if (position[id] != Prog::kNone)
+      return position[id];
+    const Inst &inst = prog.insts[prog.pcOf(id)];
+    CharClass cc;
+    if (inst.type() == StateType::STATE_CHAR)
+      cc.addChar(static_cast<char>(inst.arg));
+    else if (inst.type() == StateType::STATE_CHARCLASS)
+      cc = prog.classes[inst.arg];
+    else
+      cc = prog.classes[prog.repeats[inst.arg].cls];
+    position[id] = static_cast<ut32>(g.ids_.size());
+    g.ids_.push_back(id);
+    g.classes_.push_back(cc);
+    return position[id];
+  };
+
+  g.ids_.push_back(Prog::kNone);
+  g.classes_.push_back(CharClass());
+  for (ut32 p = 0; p < g.ids_.size(); p++) {
+    ut32 from = prog.start;
+    if (p > 0) {
+      const Inst &inst = prog.insts[prog.pcOf(g.ids_[p])];
+      from = inst.type() == StateType::STATE_REPEAT ? prog.advance(g.ids_[p])
+                                                    : inst.out;
+    }
+    g.first_edge_.push_back(static_cast<ut32>(g.edges_.size()));
+
+    stack.push_back({from, 0, 0});
+    while (!stack.empty()) {
+      Frame f = stack.back();
+      stack.pop_back();
+      if (f.id == Prog::kNone)
+        continue;
+      bool covered = false;
+      for (ut32 m = 0; m < 16 && !covered; m++)
+        covered = ((seen[f.id] >> m) & 1) && (m & ~f.asserts) == 0;
+      if (covered)
+        continue;
+      if (!seen[f.id])
+        touched.push_back(f.id);
+      seen[f.id] |= static_cast<ut16>(1u << f.asserts);
+
+      ut32 count;
+      const Inst &inst = prog.insts[prog.pcOf(f.id, &count)];
+      switch (inst.type()) {
+      case StateType::STATE_SPLIT:
+        if (inst.greedy) {
+          stack.push_back({inst.out1, f.asserts, f.slots});
+          stack.push_back({inst.out, f.asserts, f.slots});
+        } else {
+          stack.push_back({inst.out, f.asserts, f.slots});
+          stack.push_back({inst.out1, f.asserts, f.slots});
+        }
+        break;
+      case StateType::STATE_ASSERTION: {
+        AssertionType a = static_cast<AssertionType>(inst.arg);
+        ut32 bit = a == AssertionType::ASSERT_NONE ? 0 : assertBit(a);
+        stack.push_back({inst.out, f.asserts | bit, f.slots});
+        break;
+      }
+      case StateType::STATE_CAPTURE_START:
+      case StateType::STATE_CAPTURE_END: {
+        ut64 slots = f.slots;
+        if (inst.arg >= 0 && inst.arg <= prog.num_captures) {
+          bool end = inst.type() == StateType::STATE_CAPTURE_END;
+          slots |= 1ULL << (2 * inst.arg + (end ? 1 : 0));
+        }
+        stack.push_back({inst.out, f.asserts, slots});
+        break;
+      }
+      case StateType::STATE_REPEAT: {
+        const Prog::Repeat &r = prog.repeats[inst.arg];
+        if (count < r.max)
+          g.edges_.push_back({enter(f.id), f.asserts, f.slots});
+        if (count >= r.min)
+          stack.push_back({inst.out, f.asserts, f.slots});
+        break;
+      }
+      case StateType::STATE_MATCH:
+        g.edges_.push_back({kAccept, f.asserts, f.slots});
+        break;
+      default: // STATE_CHAR, STATE_CHARCLASS
+        g.edges_.push_back({enter(f.id), f.asserts, f.slots});
+        break;
+      }
+    }
+    for (ut32 id : touched)
+      seen[id] = 0;
+    touched.clear();
+  }
+  g.first_edge_.push_back(static_cast<ut32>(g.edges_.size()));
+
+  if (g.size() > kMaxParallel)
+    return g;
+  g.next_.assign((g.size() + 7) / 8, std::array<ut64, 256>{});
+  for (ut32 p = 0; p < g.size(); p++) {
+    ut64 bit = 1ULL << p;
+    if (p > 0)
+      for (ut32 b = 0; b < 256; b++)
+        if (g.classes_[p].matches(static_cast<char>(b)))
+          g.consumes_[b] |= bit;
+    for (ut32 k = g.first_edge_[p]; k < g.first_edge_[p + 1]; k++) {
+      const Edge &e = g.edges_[k];
+      if (e.asserts) {
+        g.guarded_ |= bit;
+      } else if (e.to == kAccept) {
+        g.accept_ |= bit;
+      } else {
+        std::array<ut64, 256> &row = g.next_[p / 8];
+        for (ut32 v = 0; v < 256; v++)
+          if ((v >> (p % 8)) & 1)
+            row[v] |= 1ULL << e.to;
+      }
+    }
+  }
+  return g;
+}
+
+bool GlushkovNFA::holds(ut32 asserts, st32 prev, st32 next) {
+  if ((asserts & assertBit(AssertionType::ASSERT_START_LINE)) && prev >= 0)
+    return false;
+  if ((asserts & assertBit(AssertionType::ASSERT_END_LINE)) && next >= 0)
+    return false;
+  if ((asserts & assertBit(AssertionType::ASSERT_WORD_BOUND)) &&
+      isWordByte(prev) == isWordByte(next))
+    return false;
+  return true;
+}
+
+// Unconditional edges come from the tables, 8 source positions per
+// lookup; only positions with guarded edges walk their edge lists.
+ut64 GlushkovNFA::follow(ut64 live, st32 prev, st32 next) const {
+  ut64 out = 0;
+  for (size_t k = 0; k < next_.size(); k++)
+    out |= next_[k][(live >> (8 * k)) & 255];
+  for (ut64 rest = live & guarded_; rest; rest &= rest - 1) {
+    ut32 p = lowestBit(rest);
+    for (ut32 k = first_edge_[p]; k < first_edge_[p + 1]; k++) {
+      const Edge &e = edges_[k];
+      if (e.asserts && e.to != kAccept && holds(e.asserts, prev, next))
+        out |= 1ULL << e.to;
+    }
+  }
+  return out;
+}
+
+bool GlushkovNFA::accepts(ut64 live, st32 prev, st32 next) const {
+  if (live & accept_)
+    return true;
+  for (ut64 rest = live & guarded_; rest; rest &= rest - 1) {
+    ut32 p = lowestBit(rest);
+    for (ut32 k = first_edge_[p]; k < first_edge_[p + 1]; k++) {
+      const Edge &e = edges_[k];
+      if (e.asserts && e.to == kAccept && holds(e.asserts, prev, next))
+        return true;
+    }
+  }
+  return false;
+}
+
+bool GlushkovNFA::match(std::string_view s) const {
+  ut64 live = 1; // The start position
+  st32 prev = -1;
+  for (size_t i = 0; i < s.length(); i++) {
+    st32 byte = static_cast<ut8>(s[i]);
+    live = follow(live, prev, byte) & consumes_[byte];
+    if (!live)
+      return false;
+    prev = byte;
+  }
+  return accepts(live, prev, -1);
+}
+
+// The start position is live again at every boundary, so this finds
+// whether any substring matches without caring which one.
+bool GlushkovNFA::search(std::string_view s) const {
+  ut64 live = 0;
+  st32 prev = -1;
+  for (size_t i = 0; i <= s.length(); i++) {
+    st32 byte = i < s.length() ? static_cast<ut8>(s[i]) : -1;
+    live |= 1;
+    if (accepts(live, prev, byte))
+      return true;
+    if (byte < 0)
+      break;
+    live = follow(live, prev, byte) & consumes_[byte];
+    prev = byte;
+  }
+  return false;
+}
+
+bool GlushkovNFA::empty() const { return ids_.empty(); }
+
+ut32 GlushkovNFA::size() const { return static_cast<ut32>(ids_.size()); }
+
+ut32 GlushkovNFA::id(ut32 p) const { return ids_[p]; }
+
+const CharClass &GlushkovNFA::classOf(ut32 p) const { return classes_[p]; }
+
+const GlushkovNFA::Edge *GlushkovNFA::edges(ut32 p) const {
+  return edges_.data() + first_edge_[p];
+}
+
+ut32 GlushkovNFA::edgeCount(ut32 p) const {
+  return first_edge_[p + 1] - first_edge_[p];
+}
+
+bool GlushkovNFA::parallel() const { return !next_.empty(); }
+
+size_t GlushkovNFA::bytes() const {
+  return ids_.capacity() * sizeof(ut32) +
+         classes_.capacity() * sizeof(CharClass) +
+         first_edge_.capacity() * sizeof(ut32) +
+         edges_.capacity() * sizeof(Edge) +
+         next_.capacity() * sizeof(std::array<ut64, 256>);
+}
@@ -0,0 +1,440 @@
+/// NFA_GREP_ENTRY_POINT.cpp - Command-line search over memory-mapped files
+#include "NFA.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef PzRegex::MatchSpan MatchSpan;
+typedef PzRegex::Prefilter Prefilter;
+typedef PzRegex::Regex Regex;
+typedef PzRegex::WorkPool WorkPool;
+
+namespace {
+struct Options {
+  bool count = false;  // -c: print the number of matching lines
+  bool only = false;   // -o: print each match instead of the line
+  bool number = false; // -n: prefix output with the line number
+  bool recursive = false; // -r: search directories recursively
+  bool names = false;  // Several inputs: prefix output with the file name
+};
+
+// Whole input as one read-only view. Regular files are mapped; pipes and
+// empty files are read into a buffer instead.
+class MappedFile {
+private:
+  const char *data_ = nullptr; // Start of the contents
+  size_t size_ = 0;            // Length of the contents
+  bool mapped_ = false;        // data_ came from mmap
+  std::string buffer_;         // Contents when they could not be mapped
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  void close() {
+    if (mapped_)
+      munmap(const_cast<char *>(data_), size_);
+    mapped_ = false;
+    data_ = nullptr;
+    size_ = 0;
+    std::string().swap(buffer_);
+  }
+
+  bool open(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+      return false;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                     MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(p);
+        size_ = static_cast<size_t>(st.st_size);
+        mapped_ = true;
+        return true;
+      }
+    }
+    char chunk[1 << 16];
+    for (;;) {
+      ssize_t n = read(fd, chunk, sizeof(chunk));
+      if (n == 0)
+        break;
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      buffer_.append(chunk, static_cast<size_t>(n));
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+  }
+
+  std::string_view view() const { return std::string_view(data_, size_); }
+};
+
+// Buffered stdout, flushed in large writes
+class Output {
+private:
+  std::string buf_;
+
+public:
+  Output() { buf_.reserve(1 << 17); }
+  ~Output() { flush(); }
+
+  void put(std::string_view s) {
+    buf_.append(s.data(), s.length());
+    if (buf_.size() >= (1 << 16))
+      flush();
+  }
+  void put(char c) { buf_.push_back(c); }
+  void flush() {
+    if (!buf_.empty())
+      fwrite(buf_.data(), 1, buf_.size(), stdout);
+    buf_.clear();
+  }
+};
+
+// Files larger than this are split into line-aligned chunks so one huge
+// log does not leave the other workers idle.
+constexpr ut64 kChunkSize = 8u << 20;
+
+// One input. It is mapped by whichever chunk gets to it first and unmapped
+// once its last chunk has been printed.
+struct InputFile {
+  std::string name;     // As given or as found by the walk
+  bool is_stdin = false;
+  ut64 size = 0;        // Size seen by the walk
+  int error = 0;        // errno of a failed stat/open, 0 if fine
+  std::once_flag once;  // Guards the mapping
+  MappedFile file;
+};
+
+struct Hit {
+  size_t line;           // Line number relative to the chunk's first line
+  std::string_view text; // Line or match, pointing into the mapping
+};
+
+// A byte range of one file. Lines are owned by the chunk they start in.
+struct Chunk {
+  size_t file;                // Index into the file list
+  ut64 begin, end;            // Byte range, end clamped to the file size
+  bool first, last;           // First/last chunk of its file
+  std::vector<Hit> hits;      // Output, formatted when printed
+  size_t matches = 0;         // Matching lines
+  size_t lines = 0;           // Newlines in the owned lines (for -n)
+  std::atomic<bool> done{false};
+};
+
+void usage() {
+  fprintf(stderr, "usage: nfa_grep [-c] [-n] [-o] [-r] PATTERN [FILE...]\n"
+                  "  -c  print only a count of matching lines\n"
+                  "  -n  prefix each output line with its line number\n"
+                  "  -o  print only the matched parts of a line\n"
+                  "  -r  search directories recursively\n");
+}
+
+void putPrefix(Output &out, const std::string &name, size_t lineno,
+               const Options &opts) {
+  if (opts.names) {
+    out.put(name);
+    out.put(':');
+  }
+  if (opts.number) {
+    out.put(std::to_string(lineno));
+    out.put(':');
+  }
+}
+
+// First line start at or after pos
+size_t lineStartAt(std::string_view buf, size_t pos) {
+  if (pos == 0)
+    return 0;
+  if (pos > buf.length())
+    return buf.length();
+  const void *nl = memchr(buf.data() + pos - 1, '\n', buf.length() - pos + 1);
+  return nl ? static_cast<const char *>(nl) - buf.data() + 1 : buf.length();
+}
+
+// Lines are matched in place. With a prefilter, lines without a candidate
+// are skipped wholesale: the scan jumps to the next candidate and only the
+// line around it is searched. Candidates are only looked for up to stop, so
+// a chunk never scans the rest of the file for a literal that is not there.
+void scanChunk(const Regex &re, std::string_view buf, const Options &opts,
+               Chunk *c) {
+  const Prefilter &pf = re.prog().prefilter;
+  size_t first = lineStartAt(buf, c->begin);
+  size_t stop = lineStartAt(buf, c->end);
+  std::string_view owned = buf.substr(0, stop); // Ends with our last line
+  size_t lineno = 0;   // Line number of position `counted`
+  size_t counted = first;
+  size_t pos = first;
+
+  while (pos < stop) {
+    size_t lineStart = pos;
+    if (!pf.empty()) {
+      size_t cand = pf.find(owned, pos);
+      if (cand == Prefilter::npos)
+        break;
+      lineStart = cand;
+      while (lineStart > pos && buf[lineStart - 1] != '\n')
+        lineStart--;
+    }
+    const void *nl =
+        memchr(buf.data() + lineStart, '\n', buf.length() - lineStart);
+    size_t lineEnd =
+        nl ? static_cast<const char *>(nl) - buf.data() : buf.length();
+    std::string_view line = buf.substr(lineStart, lineEnd - lineStart);
+    pos = lineEnd + 1;
+
+    MatchSpan span;
+    if (!re.find(line, &span))
+      continue;
+    c->matches++;
+    if (opts.count)
+      continue;
+
+    if (opts.number) {
+      lineno += std::count(buf.begin() + counted, buf.begin() + lineStart,
+                           '\n');
+      counted = lineStart;
+    }
+    if (!opts.only) {
+      c->hits.push_back({lineno, line});
+      continue;
+    }
+    // Every non-empty match in the line, searching on from the last end
+    for (;;) {
+      size_t start = static_cast<size_t>(span.start);
+      size_t end = static_cast<size_t>(span.end);
+      if (end > start)
+        c->hits.push_back({lineno, line.substr(start, end - start)});
+      size_t from = end > start ? end : end + 1;
+      if (from > line.length() || !re.find(line, &span, from))
+        break;
+    }
+  }
+
+  if (opts.number)
+    c->lines = std::count(buf.begin() + first, buf.begin() + stop, '\n');
+}
+
+// Prints finished chunks strictly in order. Whoever finishes a chunk
+// drains every consecutive finished chunk at the front.
+class Printer {
+private:
+  std::deque<InputFile> &files_;
+  std::deque<Chunk> &chunks_;
+  const Options &opts_;
+  Output out_;
+  std::mutex lock_;
+  size_t next_ = 0;         // First chunk not printed yet
+  size_t file_matches_ = 0; // Matching lines so far in the current file
+  size_t line_base_ = 1;    // Line number of the current chunk's first line
+
+public:
+  bool any = false;   // Some line matched
+  bool error = false; // Some input could not be read
+
+  Printer(std::deque<InputFile> &files, std::deque<Chunk> &chunks,
+          const Options &opts)
+      : files_(files), chunks_(chunks), opts_(opts) {}
+
+  void drain() {
+    std::lock_guard<std::mutex> lk(lock_);
+    while (next_ < chunks_.size() && chunks_[next_].done.load()) {
+      Chunk &c = chunks_[next_++];
+      InputFile &f = files_[c.file];
+      if (c.first) {
+        file_matches_ = 0;
+        line_base_ = 1;
+        if (f.error) {
+          out_.flush();
+          fflush(stdout);
+          fprintf(stderr, "nfa_grep: %s: %s\n", f.name.c_str(),
+                  std::strerror(f.error));
+          error = true;
+        }
+      }
+      for (const Hit &h : c.hits) {
+        putPrefix(out_, f.name, line_base_ + h.line, opts_);
+        out_.put(h.text);
+        out_.put('\n');
+      }
+      std::vector<Hit>().swap(c.hits);
+      file_matches_ += c.matches;
+      line_base_ += c.lines;
+      if (c.last) {
+        if (opts_.count && !f.error) {
+          if (opts_.names) {
+            out_.put(f.name);
+            out_.put(':');
+          }
+          out_.put(std::to_string(file_matches_));
+          out_.put('\n');
+        }
+        if (file_matches_ > 0)
+          any = true;
+        f.file.close();
+      }
+    }
+  }
+
+  void flush() { out_.flush(); }
+};
+
+// Walk on the calling thread. Directories are listed in name order, and
+// symbolic links are only followed when named on the command line.
+void walk(const std::string &path, bool top, const Options &opts,
+          std::deque<InputFile> *files) {
+  struct stat st;
+  int rc = top ? stat(path.c_str(), &st) : lstat(path.c_str(), &st);
+  if (rc != 0 || (S_ISDIR(st.st_mode) && !opts.recursive)) {
+    files->emplace_back();
+    files->back().name = path;
+    files->back().error = rc != 0 ? errno : EISDIR;
+    return;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+      files->emplace_back();
+      files->back().name = path;
+      files->back().error = errno;
+      return;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *e = readdir(dir)) {
+      if (std::strcmp(e->d_name, ".") != 0 && std::strcmp(e->d_name, "..") != 0)
+        names.push_back(e->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    std::string prefix = path.back() == '/' ? path : path + '/';
+    for (const std::string &n : names)
+      walk(prefix + n, false, opts, files);
+    return;
+  }
+  if (!top && !S_ISREG(st.st_mode))
+    return; // Links, devices, sockets and fifos found by the walk
+  files->emplace_back();
+  files->back().name = path;
+  files->back().size = S_ISREG(st.st_mode) ? static_cast<ut64>(st.st_size) : 0;
+}
+
+void mapFile(InputFile &f) {
+  int fd = f.is_stdin ? STDIN_FILENO : ::open(f.name.c_str(), O_RDONLY);
+  if (fd < 0 || !f.file.open(fd))
+    f.error = errno;
+  if (fd >= 0 && !f.is_stdin)
+    close(fd);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+    if (std::strcmp(argv[arg], "--") == 0) {
+      arg++;
+      break;
+    }
+    for (const char *f = argv[arg] + 1; *f; f++) {
+      switch (*f) {
+      case 'c':
+        opts.count = true;
+        break;
+      case 'o':
+        opts.only = true;
+        break;
+      case 'n':
+        opts.number = true;
+        break;
+      case 'r':
+        opts.recursive = true;
+        break;
+      default:
+        fprintf(stderr, "nfa_grep: unknown option -%c\n", *f);
+        usage();
+        return 2;
+      }
+    }
+  }
+  if (arg >= argc) {
+    usage();
+    return 2;
+  }
+
+  std::unique_ptr<Regex> re;
+  try {
+    re = std::make_unique<Regex>(Regex::parse(argv[arg++]));
+  } catch (const std::exception &e) {
+    fprintf(stderr, "nfa_grep: %s\n", e.what());
+    return 2;
+  }
+
+  std::vector<std::string> paths(argv + arg, argv + argc);
+  if (paths.empty())
+    paths.push_back(opts.recursive ? "." : "-");
+  opts.names = opts.recursive || paths.size() > 1;
+
+  std::deque<InputFile> files;
+  for (const std::string &path : paths) {
+    if (path == "-") {
+      files.emplace_back();
+      files.back().name = "(standard input)";
+      files.back().is_stdin = true;
+    } else {
+      walk(path, true, opts, &files);
+    }
+  }
+
+  std::deque<Chunk> chunks;
+  for (size_t i = 0; i < files.size(); i++) {
+    const InputFile &f = files[i];
+    ut64 size = f.error || f.is_stdin ? 0 : f.size;
+    ut64 at = 0;
+    do {
+      chunks.emplace_back();
+      Chunk &c = chunks.back();
+      c.file = i;
+      c.begin = at;
+      at = size - at > kChunkSize ? at + kChunkSize : size;
+      c.end = at < size ? at : UT64_MAX; // Last chunk runs to the real end
+      c.first = c.begin == 0;
+      c.last = at >= size;
+    } while (at < size);
+  }
+
+  Printer printer(files, chunks, opts);
+  WorkPool::shared().parallelFor(chunks.size(), [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) {
+      Chunk &c = chunks[i];
+      InputFile &f = files[c.file];
+      std::call_once(f.once, [&] {
+        if (!f.error)
+          mapFile(f);
+      });
+      if (!f.error) {
+        std::string_view buf = f.file.view();
+        c.end = std::min<ut64>(c.end, buf.length());
+        c.begin = std::min<ut64>(c.begin, c.end);
+        scanChunk(*re, buf, opts, &c);
+      }
+      c.done.store(true);
+      printer.drain();
+    }
+  });
+  printer.drain();
+  printer.flush();
+  return printer.error ? 2 : (printer.any ? 0 : 1);
+}
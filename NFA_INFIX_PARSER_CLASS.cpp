@@ -0,0 +1,348 @@
+#include "NFA.hpp"
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::Node Node;
+typedef PzRegex::NodeType NodeType;
+typedef PzRegex::AssertionType AssertionType;
+typedef PzRegex::NFABuilder NFABuilder;
+typedef PzRegex::InfixParser InfixParser;
+
+// InfixParser implementation
+InfixParser::InfixParser(NFABuilder &builder, std::string_view pattern)
+    : b_(builder), pattern_(pattern) {}
+
+void InfixParser::fail(const char *what) const {
+  PzError::report_error(PzError::PzErrorType::PZ_INVALID_INPUT,
+                        std::string("regex: ") + what + " at offset " +
+                            std::to_string(pos_));
+}
+
+// Groups open and close in a loop instead of recursing, so a deeply
+// nested pattern cannot overflow the thread stack.
+Node *InfixParser::parse() {
+  groups_.clear();
+  groups_.push_back(openGroup(nullptr));
+
+  while (pos_ < pattern_.length()) {
+    char c = pattern_[pos_];
+    if (c == '|') {
+      pos_++;
+      closeAlternative(groups_.back());
+      continue;
+    }
+    if (c == '(') {
+      size_t at = pos_++;
+      Node *capture = nullptr;
+      if (pattern_.substr(pos_, 2) == "?:") {
+        pos_ += 2;
+      } else {
+        capture = b_.newNode(NodeType::NODE_CAPTURE);
+        capture->capture = b_.next_capture_index_++;
+      }
+      groups_.push_back(openGroup(capture));
+      groups_.back().at = at;
+      continue;
+    }
+
+    Node *atom;
+    if (c == ')') {
+      if (groups_.size() == 1)
+        fail("unmatched )");
+      pos_++;
+      atom = closeGroup();
+    } else {
+      atom = parseAtom();
+    }
+    atom = parseQuantifiers(atom);
+    Group &g = groups_.back();
+    (g.seq_last ? g.seq_last->next : g.seq->child) = atom;
+    g.seq_last = atom;
+  }
+
+  if (groups_.size() > 1) {
+    pos_ = groups_.back().at;
+    fail("missing )");
+  }
+  closeAlternative(groups_.back());
+  return groups_.back().alt;
+}
+
+InfixParser::Group InfixParser::openGroup(Node *capture) {
+  Group g;
+  g.alt = b_.newNode(NodeType::NODE_ALTERNATE);
+  g.alt_last = nullptr;
+  g.seq = b_.newNode(NodeType::NODE_CONCAT);
+  g.seq_last = nullptr;
+  g.capture = capture;
+  g.at = pos_;
+  return g;
+}
+
+// An empty alternative is an empty concatenation, which matches ""
+void InfixParser::closeAlternative(Group &g) {
+  (g.alt_last ? g.alt_last->next : g.alt->child) = g.seq;
+  g.alt_last = g.seq;
+  g.seq = b_.newNode(NodeType::NODE_CONCAT);
+  g.seq_last = nullptr;
+}
+
+Node *InfixParser::closeGroup() {
+  closeAlternative(groups_.back());
+  Group g = groups_.back();
+  groups_.pop_back();
+  if (!g.capture)
+    return g.alt;
+  g.capture->child = g.alt;
+  return g.capture;
+}
+
+Node *InfixParser::parseQuantifiers(Node *e) {
+  auto repeat = [&](st32 min, st32 max, bool greedy) {
+    Node *r = b_.newNode(NodeType::NODE_REPEAT);
+    r->child = e;
+    r->min = min;
+    r->max = max;
+    r->greedy = greedy;
+    return r;
+  };
+  while (pos_ < pattern_.length()) {
+    char c = pattern_[pos_];
+    st32 min = 0, max = 0;
+    if (c == '{') {
+      size_t at = pos_;
+      if (!parseCount(&min, &max))
+        return e; // A literal {, left for the next atom
+      if (pos_ < pattern_.length() && pattern_[pos_] == '?') {
+        pos_ = at;
+        fail("non-greedy counted repetition is not supported");
+      }
+      e = repeat(min, max, true);
+      continue;
+    }
+    if (c == '*') {
+      max = -1;
+    } else if (c == '+') {
+      min = 1;
+      max = -1;
+    } else if (c == '?') {
+      max = 1;
+    } else {
+      return e;
+    }
+    pos_++;
+    bool lazy = pos_ < pattern_.length() && pattern_[pos_] == '?';
+    if (lazy)
+      pos_++;
+    e = repeat(min, max, !lazy);
+  }
+  return e;
+}
+
+// {n}, {n,} or {n,m}. Anything else is not a count and leaves pos_ alone.
+bool InfixParser::parseCount(st32 *min, st32 *max) {
+  size_t i = pos_ + 1;
+  auto number = [&](st32 *v) {
+    size_t begin = i;
+    st64 n = 0;
+    while (i < pattern_.length() && isdigit(static_cast<ut8>(pattern_[i]))) {
+      n = n * 10 + (pattern_[i] - '0');
+      if (n > 100000)
+        fail("repetition count too large");
+      i++;
+    }
+    *v = static_cast<st32>(n);
+    return i > begin;
+  };
+  if (!number(min))
+    return false;
+  *max = *min;
+  if (i < pattern_.length() && pattern_[i] == ',') {
+    i++;
+    if (i < pattern_.length() && pattern_[i] == '}')
+      *max = -1;
+    else if (!number(max))
+      return false;
+  }
+  if (i >= pattern_.length() || pattern_[i] != '}')
+    return false;
+  if (*max >= 0 && *max < *min)
+    fail("repetition count out of order");
+  pos_ = i + 1;
+  return true;
+}
+
+Node *InfixParser::parseAtom() {
+  auto classNode = [&](const CharClass &cc) {
+    Node *n = b_.newNode(NodeType::NODE_CLASS);
+    n->cc = cc;
+    return n;
+  };
+  auto assertNode = [&](AssertionType a) {
+    Node *n = b_.newNode(NodeType::NODE_ASSERTION);
+    n->assertion = a;
+    return n;
+  };
+  auto literalNode = [&](char b) {
+    Node *n = b_.newNode(NodeType::NODE_LITERAL);
+    n->text = b_.arena_.copy(std::string_view(&b, 1));
+    return n;
+  };
+
+  char c = pattern_[pos_];
+  switch (c) {
+  case '[': {
+    pos_++;
+    CharClass cc;
+    parseClass(&cc);
+    return classNode(cc);
+  }
+  case '.': {
+    pos_++;
+    CharClass cc;
+    cc.addChar('\n');
+    cc.negate();
+    return classNode(cc);
+  }
+  case '^':
+    pos_++;
+    return assertNode(AssertionType::ASSERT_START_LINE);
+  case '$':
+    pos_++;
+    return assertNode(AssertionType::ASSERT_END_LINE);
+  case '*':
+  case '+':
+  case '?':
+    fail("quantifier without operand");
+    return nullptr;
+  case '\\': {
+    pos_++;
+    if (pos_ >= pattern_.length())
+      fail("trailing backslash");
+    if (pattern_[pos_] == 'b') {
+      pos_++;
+      return assertNode(AssertionType::ASSERT_WORD_BOUND);
+    }
+    CharClass cc;
+    if (parseClassEscape(&cc))
+      return classNode(cc);
+    return literalNode(parseEscapedByte());
+  }
+  default:
+    pos_++;
+    return literalNode(c);
+  }
+}
+
+// \d \w \s and \D \W \S, with pos_ on the letter
+bool InfixParser::parseClassEscape(CharClass *cc) {
+  char e = pattern_[pos_];
+  CharClass add;
+  switch (e | 0x20) {
+  case 'd':
+    add.addRange('0', '9');
+    break;
+  case 'w':
+    add.addRange('a', 'z');
+    add.addRange('A', 'Z');
+    add.addRange('0', '9');
+    add.addChar('_');
+    break;
+  case 's':
+    add.addChar(' ');
+    add.addRange('\t', '\r'); // \t \n \v \f \r
+    break;
+  default:
+    return false;
+  }
+  if (e >= 'A' && e <= 'Z')
+    add.negate();
+  for (size_t w = 0; w < add.bits.size(); w++)
+    cc->bits[w] |= add.bits[w];
+  pos_++;
+  return true;
+}
+
+// Byte named by the escape at pos_; unknown escapes stand for themselves
+char InfixParser::parseEscapedByte() {
+  char e = pattern_[pos_++];
+  switch (e) {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  case 'f':
+    return '\f';
+  case 'v':
+    return '\v';
+  case 'x': {
+    st32 v = 0;
+    for (st32 k = 0; k < 2; k++) {
+      char h = pos_ < pattern_.length() ? pattern_[pos_] : '\0';
+      if (!isxdigit(static_cast<ut8>(h)))
+        fail("bad \\x escape");
+      v = v * 16 + (isdigit(static_cast<ut8>(h)) ? h - '0' : (h | 0x20) - 'a' + 10);
+      pos_++;
+    }
+    return static_cast<char>(v);
+  }
+  case 'B':
+    pos_--;
+    fail("\\B is not supported");
+    return e;
+  default:
+    return e;
+  }
+}
+
+// With pos_ just past the [. A ] right after [ or [^ is a member.
+void InfixParser::parseClass(CharClass *cc) {
+  size_t open = pos_ - 1;
+  bool negated = pos_ < pattern_.length() && pattern_[pos_] == '^';
+  if (negated)
+    pos_++;
+
+  bool first = true;
+  while (pos_ < pattern_.length() && (first || pattern_[pos_] != ']')) {
+    first = false;
+    char lo = pattern_[pos_];
+    if (lo == '\\') {
+      pos_++;
+      if (pos_ >= pattern_.length())
+        break;
+      if (parseClassEscape(cc))
+        continue;
+      lo = parseEscapedByte();
+    } else {
+      pos_++;
+    }
+
+    if (pos_ + 1 < pattern_.length() && pattern_[pos_] == '-' &&
+        pattern_[pos_ + 1] != ']') {
+      pos_++;
+      char hi = pattern_[pos_];
+      if (hi == '\\') {
+        pos_++;
+        if (pos_ >= pattern_.length())
+          break;
+        hi = parseEscapedByte();
+      } else {
+        pos_++;
+      }
+      if (static_cast<ut8>(hi) < static_cast<ut8>(lo))
+        fail("class range out of order");
+      cc->addRange(lo, hi);
+    } else {
+      cc->addChar(lo);
+    }
+  }
+
+  if (pos_ >= pattern_.length()) {
+    pos_ = open;
+    fail("missing ]");
+  }
+  pos_++;
+  if (negated)
+    cc->negate();
+}
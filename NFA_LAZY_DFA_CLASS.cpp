@@ -0,0 +1,330 @@
+#include "NFA.hpp"
+
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::AssertionType AssertionType;
+typedef PzRegex::LazyDFA LazyDFA;
+typedef PzRegex::MatchSet MatchSet;
+
+static bool isWordByte(st32 b) {
+  return b >= 0 && b < 256 && (isalnum(b) || b == '_');
+}
+
+// LazyDFA implementation
+LazyDFA::LazyDFA(std::shared_ptr<const Prog> prog, size_t maxStates,
+                 bool allMatches, bool firstMatch)
+    : prog_(std::move(prog)), max_states_(maxStates),
+      all_matches_(allMatches), first_match_(firstMatch) {
+  if (max_states_ < 2)
+    max_states_ = 2;
+  marks_.assign(prog_->ids(), 0);
+}
+
+// Depth-first ε-closure of pc in priority order, with the byte after the
+// position (or kEndOfText) known, so every assertion is decided here.
+void LazyDFA::expand(std::vector<ut32> &out, ut32 pc, ut32 flags,
+                     st32 next) {
+  stack_.clear();
+  stack_.push_back(pc);
+
+  while (!stack_.empty()) {
+    ut32 x = stack_.back();
+    stack_.pop_back();
+    if (x == Prog::kNone || marks_[x] == mark_gen_)
+      continue;
+    marks_[x] = mark_gen_;
+    ut32 count;
+    const Inst &inst = prog_->insts[prog_->pcOf(x, &count)];
+
+    switch (inst.type()) {
+    case StateType::STATE_SPLIT:
+      if (inst.greedy) {
+        stack_.push_back(inst.out1);
+        stack_.push_back(inst.out);
+      } else {
+        stack_.push_back(inst.out);
+        stack_.push_back(inst.out1);
+      }
+      break;
+    case StateType::STATE_CAPTURE_START:
+    case StateType::STATE_CAPTURE_END:
+      stack_.push_back(inst.out);
+      break;
+    case StateType::STATE_ASSERTION: {
+      AssertionType a = static_cast<AssertionType>(inst.arg);
+      bool holds;
+      if (a == AssertionType::ASSERT_START_LINE) {
+        holds = (flags & FLAG_START) != 0;
+      } else if (a == AssertionType::ASSERT_END_LINE) {
+        holds = next == kEndOfText;
+      } else if (a == AssertionType::ASSERT_WORD_BOUND) {
+        holds = ((flags & FLAG_WORD) != 0) != isWordByte(next);
+      } else {
+        holds = true;
+      }
+      if (holds)
+        stack_.push_back(inst.out);
+      break;
+    }
+    case StateType::STATE_REPEAT: {
+      const Prog::Repeat &r = prog_->repeats[inst.arg];
+      if (count < r.max)
+        out.push_back(x);
+      if (count >= r.min)
+        stack_.push_back(inst.out);
+      break;
+    }
+    default: // STATE_CHAR, STATE_CHARCLASS, STATE_MATCH
+      out.push_back(x);
+      break;
+    }
+  }
+}
+
+// One walk over every entry of a state, sharing the visit marks, exactly
+// as NFASimulator::addThread fills a thread list.
+void LazyDFA::resolve(std::vector<ut32> &out, const std::vector<ut32> &in,
+                      ut32 flags, st32 next) {
+  mark_gen_++;
+  for (ut32 pc : in)
+    expand(out, pc, flags, next);
+}
+
+st32 LazyDFA::intern(std::vector<ut32> &&insts, ut32 flags,
+                     std::vector<ut32> &&matched) {
+  StateKey key(flags, std::move(insts), std::move(matched));
+  auto it = cache_.find(key);
+  if (it != cache_.end())
+    return it->second;
+
+  st32 d = static_cast<st32>(dstates_.size());
+  DState ds;
+  ds.insts = std::get<1>(key);
+  ds.flags = flags;
+  ds.matched = std::get<2>(key);
+  dstates_.push_back(std::move(ds));
+  cache_.emplace(std::move(key), d);
+  trans_.resize(trans_.size() + kStride, kUnknown);
+  return d;
+}
+
+st32 LazyDFA::computeNext(st32 d, st32 byte) {
+  std::vector<ut32> ready;
+  resolve(ready, dstates_[d].insts, dstates_[d].flags, byte);
+
+  ut32 flags = flagsAfter(byte);
+  std::vector<ut32> next;
+  std::vector<ut32> matched;
+  mark_gen_++;
+  auto enter = [&](ut32 id) {
+    if (marks_[id] != mark_gen_) {
+      marks_[id] = mark_gen_;
+      next.push_back(id);
+    }
+  };
+  for (ut32 id : ready) {
+    const Inst &inst = prog_->insts[prog_->pcOf(id)];
+    if (all_matches_ && inst.type() == StateType::STATE_MATCH) {
+      matched.push_back(static_cast<ut32>(inst.arg));
+      continue;
+    }
+    if (first_match_ && inst.type() == StateType::STATE_MATCH) {
+      matched.push_back(static_cast<ut32>(inst.arg));
+      break; // Leftmost-first: lower-priority threads are cut off
+    }
+    if ((inst.type() == StateType::STATE_CHAR && inst.arg == byte) ||
+        (inst.type() == StateType::STATE_CHARCLASS &&
+         prog_->classes[inst.arg].matches(static_cast<char>(byte)))) {
+      enter(inst.out);
+    } else if (inst.type() == StateType::STATE_REPEAT &&
+               prog_->classes[prog_->repeats[inst.arg].cls].matches(
+                   static_cast<char>(byte))) {
+      enter(prog_->advance(id));
+    }
+  }
+
+  std::sort(matched.begin(), matched.end());
+  st32 n = next.empty() && matched.empty()
+               ? kDead
+               : intern(std::move(next), flags, std::move(matched));
+  trans_[static_cast<size_t>(d) * kStride + byte] = n;
+  return n;
+}
+
+bool LazyDFA::acceptsAtEnd(st32 d) {
+  if (dstates_[d].accepts < 0) {
+    std::vector<ut32> ready;
+    resolve(ready, dstates_[d].insts, dstates_[d].flags, kEndOfText);
+    std::vector<ut32> ids;
+    for (ut32 id : ready) {
+      const Inst &inst = prog_->insts[prog_->pcOf(id)];
+      if (inst.type() == StateType::STATE_MATCH)
+        ids.push_back(static_cast<ut32>(inst.arg));
+    }
+    dstates_[d].accepts = ids.empty() ? 0 : 1;
+    dstates_[d].end_ids = std::move(ids);
+  }
+  return dstates_[d].accepts == 1;
+}
+
+st32 LazyDFA::flush(st32 keep) {
+  DState saved = std::move(dstates_[keep]);
+  dstates_.clear();
+  cache_.clear();
+  trans_.clear();
+  for (auto &row : start_)
+    std::fill(std::begin(row), std::end(row), kUnknown);
+  return intern(std::move(saved.insts), saved.flags, std::move(saved.matched));
+}
+
+st32 LazyDFA::startState(bool anchored, ut32 flags) {
+  st32 &start = start_[anchored ? 0 : 1][flags];
+  if (start == kUnknown) {
+    std::vector<ut32> insts = {anchored ? prog_->start : prog_->unanchored};
+    start = intern(std::move(insts), flags, std::vector<ut32>());
+  }
+  return start;
+}
+
+ut32 LazyDFA::flagsAfter(st32 byte) {
+  if (byte < 0)
+    return FLAG_START;
+  return isWordByte(byte) ? static_cast<ut32>(FLAG_WORD) : 0u;
+}
+
+st32 LazyDFA::step(st32 d, st32 byte) {
+  st32 n = trans_[static_cast<size_t>(d) * kStride + byte];
+  if (n == kUnknown) {
+    if (dstates_.size() >= max_states_)
+      d = flush(d);
+    n = computeNext(d, byte);
+  }
+  return n;
+}
+
+bool LazyDFA::match(std::string_view s) {
+  st32 d = startState(true);
+  if (d == kDead)
+    return false;
+
+  for (size_t pos = 0; pos < s.length(); pos++) {
+    d = step(d, static_cast<ut8>(s[pos]));
+    if (d == kDead)
+      return false;
+  }
+
+  return acceptsAtEnd(d);
+}
+
+// Anchored: ids whose pattern matches all of s. Unanchored: ids that match
+// somewhere, which needs allMatches so mid-input matches are recorded.
+bool LazyDFA::matchAll(std::string_view s, bool anchored, MatchSet *out) {
+  st32 d = startState(anchored);
+  if (d == kDead)
+    return !out->empty();
+
+  for (size_t pos = 0; pos < s.length(); pos++) {
+    d = step(d, static_cast<ut8>(s[pos]));
+    if (d == kDead)
+      return !out->empty();
+    if (!anchored) {
+      for (ut32 id : dstates_[d].matched)
+        out->insert(id);
+    }
+  }
+
+  if (acceptsAtEnd(d)) {
+    for (ut32 id : dstates_[d].end_ids)
+      out->insert(id);
+  }
+  return !out->empty();
+}
+
+// A match ending at pos shows in the state entered by reading the byte at
+// pos. Threads above it in priority may still find a later end, so the
+// scan goes on until nothing is left alive.
+size_t LazyDFA::findEnd(std::string_view s, size_t from) {
+  st32 prev = from > 0 ? static_cast<ut8>(s[from - 1]) : -1;
+  st32 d = startState(false, flagsAfter(prev));
+  size_t end = std::string_view::npos;
+  for (size_t pos = from; pos < s.length() && d != kDead; pos++) {
+    d = step(d, static_cast<ut8>(s[pos]));
+    if (d != kDead && !dstates_[d].matched.empty())
+      end = pos;
+  }
+  if (d != kDead && acceptsAtEnd(d))
+    end = s.length();
+  return end;
+}
+
+// The reversed program reads s backwards from end, anchored there. Its
+// start of input is the end of s and its end of input is offset 0, so ^
+// and $ already swapped sides when the program was built. A match of the
+// reversed program at offset p means s[p, end) matches the pattern.
+size_t LazyDFA::findStart(std::string_view s, size_t end, size_t from) {
+  st32 after = end < s.length() ? static_cast<ut8>(s[end]) : -1;
+  st32 d = startState(true, flagsAfter(after));
+  size_t start = std::string_view::npos;
+  for (size_t pos = end; d != kDead; pos--) {
+    if (pos == 0) {
+      if (acceptsAtEnd(d))
+        start = 0;
+      break;
+    }
+    st32 n = step(d, static_cast<ut8>(s[pos - 1]));
+    if (n != kDead && !dstates_[n].matched.empty())
+      start = pos;
+    if (pos == from)
+      break;
+    d = n;
+  }
+  return start;
+}
+
+LazyDFA::StateKey LazyDFA::startKey(bool anchored) {
+  st32 d = startState(anchored);
+  if (d == kDead)
+    return StateKey();
+  return StateKey(dstates_[d].flags, dstates_[d].insts, dstates_[d].matched);
+}
+
+// keys[k] is the state after k * every bytes and keys.back() the state at
+// the end. A match ending at offset p (reported when the byte at p is
+// read) counts for the stretch containing p. A match at the very end of s
+// is only reported when atEnd says no byte follows; otherwise it shows up
+// when the next chunk reads its first byte. An empty key is the dead state.
+void LazyDFA::trace(std::string_view s, const StateKey &entry, size_t every,
+                    bool atEnd, ScanTrace *out) {
+  out->keys.clear();
+  out->first.clear();
+  out->keys.push_back(entry);
+
+  bool dead = std::get<1>(entry).empty() && std::get<2>(entry).empty();
+  st32 d = dead ? kDead
+                : intern(std::vector<ut32>(std::get<1>(entry)),
+                         std::get<0>(entry),
+                         std::vector<ut32>(std::get<2>(entry)));
+
+  for (size_t at = 0; at < s.length(); at += every) {
+    size_t stop = std::min(s.length(), at + every);
+    size_t first = std::string_view::npos;
+    for (size_t pos = at; pos < stop && d != kDead; pos++) {
+      d = step(d, static_cast<ut8>(s[pos]));
+      if (d != kDead && first == std::string_view::npos &&
+          !dstates_[d].matched.empty())
+        first = pos;
+    }
+    if (atEnd && stop == s.length() && first == std::string_view::npos &&
+        d != kDead && acceptsAtEnd(d))
+      first = stop;
+    out->first.push_back(first);
+    if (d == kDead)
+      out->keys.push_back(StateKey());
+    else
+      out->keys.push_back(
+          StateKey(dstates_[d].flags, dstates_[d].insts, dstates_[d].matched));
+  }
+}
+
+size_t LazyDFA::state_count() const { return dstates_.size(); }
@@ -0,0 +1,502 @@
+/// NFA_MAIN_TEST_ENTRY_POINT.cpp - Regression driver for the matching engines
+//
+// Every engine NFASimulator prefers over the Pike VM is run on the same
+// patterns and inputs as a simulator with set_fast_paths(false), and any
+// difference in the result, the match span or a capture span is reported.
+// Searches are repeated from every offset of the input, and streams are
+// fed the input split at every offset. ParallelScan is checked against a
+// scan of the whole input as one chunk, and RegexSet, which has no
+// single-pattern counterpart, against one Regex per pattern.
+#include "NFA.hpp"
+#include <iostream>
+
+using namespace std;
+using namespace PzRegex;
+
+/* ---------- HARNESS ---------- */
+
+struct EngineCase {
+  const char *pattern;   // Infix syntax (Regex::parse)
+  vector<string> inputs; // Each is matched, and searched from every offset
+};
+
+static size_t checks = 0;
+static size_t failures = 0;
+
+/* Match span and every capture span, in slot order; empty for no match */
+static vector<MatchSpan> spansOf(const NFASimulator &sim, bool ok,
+                                 st32 groups) {
+  vector<MatchSpan> spans;
+  if (ok) {
+    spans.push_back(sim.get_match_span());
+    for (st32 i = 0; i < groups; i++)
+      spans.push_back(sim.get_capture_span(i));
+  }
+  return spans;
+}
+
+/* Same layout from a stream; offsets count from the start of the stream */
+static vector<MatchSpan> spansOf(const StreamMatcher &m, bool ok,
+                                 st32 groups) {
+  vector<MatchSpan> spans;
+  if (ok) {
+    spans.push_back(m.get_match_span());
+    for (st32 i = 0; i < groups; i++)
+      spans.push_back(m.get_capture_span(i));
+  }
+  return spans;
+}
+
+/* Same layout from a raw slot array (group pairs first, span last) */
+static vector<MatchSpan> spansOf(const st64 *slots, bool ok, st32 groups) {
+  vector<MatchSpan> spans;
+  if (ok) {
+    spans.push_back({slots[2 * groups], slots[2 * groups + 1]});
+    for (st32 i = 0; i < groups; i++)
+      spans.push_back({slots[2 * i], slots[2 * i + 1]});
+  }
+  return spans;
+}
+
+static string describe(const vector<MatchSpan> &spans) {
+  if (spans.empty())
+    return "no match";
+  string out;
+  for (size_t i = 0; i < spans.size(); i++) {
+    if (i > 0)
+      out += ' ';
+    out += to_string(spans[i].start) + ".." + to_string(spans[i].end);
+  }
+  return out;
+}
+
+static void report(const char *engine, const char *call, const EngineCase &t,
+                   const string &input, size_t from, const string &want,
+                   const string &got, const char *reference = "Pike VM") {
+  failures++;
+  cout << "✗ " << engine << ' ' << call << ": pattern='" << t.pattern
+       << "' text='" << input << "' from=" << from << "\n"
+       << "  " << reference << ": " << want << "\n"
+       << "  " << engine << ": " << got << "\n";
+}
+
+static void check(const char *engine, const char *call, const EngineCase &t,
+                  const string &input, size_t from,
+                  const vector<MatchSpan> &want,
+                  const vector<MatchSpan> &got) {
+  checks++;
+  bool same = want.size() == got.size();
+  for (size_t i = 0; same && i < want.size(); i++)
+    same = want[i].start == got[i].start && want[i].end == got[i].end;
+  if (!same)
+    report(engine, call, t, input, from, describe(want), describe(got));
+}
+
+/* For engines that only say whether there is a match */
+static void checkVerdict(const char *engine, const char *call,
+                         const EngineCase &t, const string &input, bool want,
+                         bool got) {
+  checks++;
+  if (want != got)
+    report(engine, call, t, input, 0, want ? "match" : "no match",
+           got ? "match" : "no match");
+}
+
+/* Only the span: what find() reports */
+static vector<MatchSpan> spanOnly(const vector<MatchSpan> &spans) {
+  return spans.empty() ? spans : vector<MatchSpan>(1, spans[0]);
+}
+
+static void requireEngine(const char *engine, const EngineCase &t,
+                          bool built) {
+  checks++;
+  if (built)
+    return;
+  failures++;
+  cout << "✗ " << engine << ": pattern='" << t.pattern
+       << "' does not build the engine this case is meant to cover\n";
+}
+
+static void section(const char *name, size_t before_checks,
+                    size_t before_failures) {
+  cout << name << ": " << checks - before_checks << " checks, "
+       << failures - before_failures << " failed\n";
+}
+
+/* ---------- GLUSHKOV NFA ---------- */
+
+static const vector<EngineCase> kGlushkovCases = {
+    {"(a|ab)(c|bcd)(d*)", {"abcd", "abcdd", "acd", "xabcd", "ab", ""}},
+    {"^(\\w+)\\s(\\w+)$", {"hello world", "hello  world", " a b", "ab"}},
+    {"\\b(foo|foobar)\\b", {"foobar", "foo bar", "xfoo", "foo_", "foo"}},
+    {"(a{2,3})(b{1,2}c)?", {"aab", "aaabbc", "aaaabc", "abbc", "aa"}},
+    {"x*(y|$)", {"", "xx", "xxy", "yx", "xyxy"}},
+    {"(\\d{3})-(\\d{2,4})", {"555-1234", "55-123", "5555-12345", "a555-12"}},
+    {"(a|b)*?b", {"aab", "bbb", "", "aaa"}},
+    {"(a*)+b", {"aab", "b", "", "ba"}},
+    {"\\b", {"", "a", " a ", "ab cd"}},
+};
+
+static void runGlushkov() {
+  size_t c0 = checks, f0 = failures;
+  for (const EngineCase &t : kGlushkovCases) {
+    Regex re = Regex::parse(t.pattern);
+    auto prog = make_shared<const Prog>(re.prog());
+    const GlushkovNFA &g = prog->glushkov;
+    requireEngine("GlushkovNFA", t, g.parallel());
+    NFASimulator ref(prog);
+    ref.set_fast_paths(false);
+    NFASimulator sim(prog);
+    sim.set_backtrack_budget(0);
+    st32 groups = prog->num_captures;
+
+    for (const string &s : t.inputs) {
+      bool ok = ref.match(s);
+      vector<MatchSpan> want = spansOf(ref, ok, groups);
+      checkVerdict("GlushkovNFA", "match", t, s, ok, g.match(s));
+      ok = sim.match(s);
+      check("NFASimulator", "match", t, s, 0, want, spansOf(sim, ok, groups));
+
+      checkVerdict("GlushkovNFA", "search", t, s, ref.search(s), g.search(s));
+    }
+  }
+  section("GlushkovNFA", c0, f0);
+}
+
+/* ---------- ONE-PASS ---------- */
+
+static const vector<EngineCase> kOnePassCases = {
+    {"(\\w+)=(\\d+)", {"key=42", "k=", "=1", "a=1b", "x key=7 y=8"}},
+    {"([a-z]+)@([a-z]+)\\.com", {"bob@ex.com", "a@b.co", "x bob@ex.comm"}},
+    {"(\\d{2}):(\\d{2})(:\\d{2})?", {"12:34", "12:34:56", "1:23", "12:345"}},
+    {"^(a+)(b*)$", {"aab", "abb", "b", "", "aba"}},
+    {"\\b(\\d+)\\b", {"12 345", "a12", "12a 7", ""}},
+    {"(x{1,3})y", {"xy", "xxxxy", "xxx", "y"}},
+};
+
+static void runOnePass() {
+  size_t c0 = checks, f0 = failures;
+  for (const EngineCase &t : kOnePassCases) {
+    Regex re = Regex::parse(t.pattern);
+    auto prog = make_shared<const Prog>(re.prog());
+    requireEngine("OnePass", t, !prog->onepass.empty());
+    NFASimulator ref(prog);
+    ref.set_fast_paths(false);
+    NFASimulator sim(prog);
+    sim.set_backtrack_budget(0);
+    st32 groups = prog->num_captures;
+
+    for (const string &s : t.inputs) {
+      bool ok = ref.match(s);
+      vector<MatchSpan> want = spansOf(ref, ok, groups);
+      ok = sim.match(s);
+      check("OnePass", "match", t, s, 0, want, spansOf(sim, ok, groups));
+
+      for (size_t from = 0; from <= s.length(); from++) {
+        ok = ref.search(s, from);
+        want = spansOf(ref, ok, groups);
+        ok = sim.search(s, from);
+        check("OnePass", "search", t, s, from, want,
+              spansOf(sim, ok, groups));
+      }
+    }
+  }
+  section("OnePass", c0, f0);
+}
+
+/* ---------- BACKTRACKER ---------- */
+
+static const vector<EngineCase> kBacktrackerCases = {
+    {"(a|ab)(c|bcd)(d*)", {"abcd", "abcdd", "acd", "xabcd", "ab"}},
+    {"(a*)(a*)b", {"aaab", "aaa", "b", "xab"}},
+    {"^(.*),(.*)$", {"a,b,c", ",", "abc", "a,"}},
+    {"(\\w+)\\s*=\\s*(\\w*)", {"key = value", "k=", " =x", "a b=c"}},
+    {"(a+?)(a*)", {"aaa", "", "baa"}},
+    {"\\b(\\w{2,4})\\b", {"ab abcde abc", "a", "abcd_"}},
+    {"(foo|foobar)(bar)?$", {"foobar", "foobarbar", "foo", "xfoobar"}},
+};
+
+static void runBacktracker() {
+  size_t c0 = checks, f0 = failures;
+  for (const EngineCase &t : kBacktrackerCases) {
+    Regex re = Regex::parse(t.pattern);
+    auto prog = make_shared<const Prog>(re.prog());
+    NFASimulator ref(prog);
+    ref.set_fast_paths(false);
+    Backtracker bt(prog);
+    st32 groups = prog->num_captures;
+    vector<st64> slots(bt.width());
+
+    for (const string &s : t.inputs) {
+      requireEngine("Backtracker", t, bt.fits(s.length()));
+      bool ok = ref.match(s);
+      vector<MatchSpan> want = spansOf(ref, ok, groups);
+      ok = bt.match(s, slots.data());
+      check("Backtracker", "match", t, s, 0, want,
+            spansOf(slots.data(), ok, groups));
+
+      for (size_t from = 0; from <= s.length(); from++) {
+        ok = ref.search(s, from);
+        want = spansOf(ref, ok, groups);
+        ok = bt.search(s, from, slots.data());
+        check("Backtracker", "search", t, s, from, want,
+              spansOf(slots.data(), ok, groups));
+      }
+    }
+  }
+  section("Backtracker", c0, f0);
+}
+
+/* ---------- FORWARD AND REVERSE DFA (find) ---------- */
+
+static const vector<EngineCase> kFindCases = {
+    {"a+", {"", "baaab", "aa"}},
+    {"(a|ab)(c|bcd)", {"abcd", "xabcdabc", "ac"}},
+    {"\\bfoo\\b", {"foo", "a foo b", "foofoo foo", "xfoo"}},
+    {"^abc", {"abc", "abcabc", "xabc"}},
+    {"abc$", {"abc", "abcabc", "abcx"}},
+    {"x*", {"", "axxb", "xx"}},
+    {"a{2,3}", {"aaaaaaa", "a a aa", "aaa"}},
+    {"[0-9]+\\.[0-9]*", {"1.5 and 22.", "...", "3..4"}},
+    {"(?:ab|a)(?:bc|c)?", {"abc", "abbc", "ac", "xab"}},
+    {"(a*)*b", {"aab", "b", "xaxb", ""}},
+    {"\\b", {"", "ab cd", " "}},
+    {"$", {"", "abc"}},
+};
+
+static void runFind() {
+  size_t c0 = checks, f0 = failures;
+  for (const EngineCase &t : kFindCases) {
+    Regex re = Regex::parse(t.pattern);
+    auto prog = make_shared<const Prog>(re.prog());
+    requireEngine("find", t, prog->reverse != nullptr);
+    NFASimulator ref(prog);
+    ref.set_fast_paths(false);
+    NFASimulator sim(prog);
+    st32 groups = prog->num_captures;
+
+    for (const string &s : t.inputs) {
+      for (size_t from = 0; from <= s.length(); from++) {
+        bool ok = ref.search(s, from);
+        vector<MatchSpan> want = spanOnly(spansOf(ref, ok, groups));
+        ok = sim.find(s, from);
+        check("find", "find", t, s, from, want,
+              spanOnly(spansOf(sim, ok, groups)));
+      }
+    }
+  }
+  section("find", c0, f0);
+}
+
+/* ---------- STREAM MATCHER ---------- */
+
+static const vector<EngineCase> kStreamCases = {
+    {"\\bfoo\\b", {"foo", "a foo b", "foofoo foo", "xfoo", "foo_"}},
+    {"(\\w+)\\s(\\w+)$", {"hello world", "a b c", "ab\ncd ef", "ab "}},
+    {"(a|ab)(c|bcd)(d*)", {"abcd", "xabcdd", "ab"}},
+    {"x*(y|$)", {"", "xx", "xxy", "yx"}},
+    {"(\\d+)-(\\d+)", {"12-345", "a1-2b", "12-"}},
+    {"^(a+)$", {"aaa", "aab", "b\naa"}},
+    {"abc", {"abc", "xxabc", "ab"}},
+    {"a{2,3}b", {"aab", "aaaab", "ab"}},
+    {"\\b", {"", " a", "ab"}},
+};
+
+static void runStreamMatcher() {
+  size_t c0 = checks, f0 = failures;
+  for (const EngineCase &t : kStreamCases) {
+    Regex re = Regex::parse(t.pattern);
+    auto prog = make_shared<const Prog>(re.prog());
+    NFASimulator ref(prog);
+    ref.set_fast_paths(false);
+    st32 groups = prog->num_captures;
+
+    for (bool anchored : {false, true}) {
+      const char *call = anchored ? "anchored" : "unanchored";
+      StreamMatcher m(prog, anchored);
+      for (const string &s : t.inputs) {
+        bool ok = anchored ? ref.match(s) : ref.search(s);
+        vector<MatchSpan> want = spansOf(ref, ok, groups);
+
+        // Two chunks, split at every offset; the split goes in `from`
+        for (size_t cut = 0; cut <= s.length(); cut++) {
+          m.reset();
+          string head = s.substr(0, cut), tail = s.substr(cut);
+          m.feed(head);
+          m.feed(tail);
+          ok = m.finish();
+          check("StreamMatcher", call, t, s, cut, want,
+                spansOf(m, ok, groups));
+        }
+
+        // One byte per chunk
+        m.reset();
+        for (char c : s)
+          m.feed(string(1, c));
+        ok = m.finish();
+        check("StreamMatcher", call, t, s, 0, want, spansOf(m, ok, groups));
+      }
+    }
+  }
+  section("StreamMatcher", c0, f0);
+}
+
+/* ---------- PARALLEL SCAN ---------- */
+
+// Each input is also tried behind 0..kMaxPad filler bytes, so that with
+// tiny chunks every match is cut by a chunk edge somewhere. The largest
+// chunk size only splits the long inputs, into chunks that record their
+// state more than once.
+static const size_t kMaxPad = 24;
+
+static const vector<EngineCase> kParallelCases = {
+    {"abcdefgh", {"abcdefgh", "abcdefgabcdefgh", "abcdefg"}},
+    {"a[^b]{6}c", {"axxxxxxc", "axxxxxbxc aaxxxxxxxc"}},
+    {"^abc", {"abc", "xabc", "x\nabc"}},
+    {"abc$", {"abc", "abcx", "abc\nx"}},
+    {"\\bfoo\\b", {"foo", "foofoo foo", "xfoo"}},
+    {"(?:ab|a)(?:bc|c)?d", {"abcd", "abd", "acd", "abbcd"}},
+    {"x*y", {"xxxxxxxxy", "xxxx"}},
+    {"a{3,5}b", {"aaaab", "aab", string(2000, 'a') + "b"}},
+    {"a[^z]*z", {"axxz", "a" + string(40000, 'x') + "z"}},
+};
+
+static string endOf(bool ok, size_t end) {
+  return ok ? "end " + to_string(end) : "no match";
+}
+
+static void runParallelScan() {
+  size_t c0 = checks, f0 = failures;
+  WorkPool pool(4);
+  for (const EngineCase &t : kParallelCases) {
+    Regex re = Regex::parse(t.pattern);
+    auto prog = make_shared<const Prog>(re.prog());
+
+    for (const string &input : t.inputs) {
+      for (size_t pad = 0; pad <= kMaxPad; pad++) {
+        string s = string(pad, '-') + input;
+        size_t want_end = 0;
+        bool want = ParallelScan(prog, s.length() + 1).find(s, &want_end);
+        for (size_t chunk : {1, 2, 3, 5, 8, 10000}) {
+          for (size_t lookback : {0, 1, 4}) {
+            size_t end = 0;
+            bool ok = ParallelScan(prog, chunk, lookback).find(s, &end, &pool);
+            checks++;
+            if (ok != want || (ok && end != want_end)) {
+              string engine = "ParallelScan(minChunk=" + to_string(chunk) +
+                              ", lookback=" + to_string(lookback) + ")";
+              report(engine.c_str(), "find", t, s, 0, endOf(want, want_end),
+                     endOf(ok, end), "one chunk");
+            }
+          }
+        }
+      }
+    }
+  }
+  section("ParallelScan", c0, f0);
+}
+
+/* ---------- REGEX SET ---------- */
+
+struct SetCase {
+  vector<string> patterns; // Postfix syntax (RegexSet, Regex)
+  vector<string> inputs;   // Each is matched and searched
+};
+
+static const vector<SetCase> kSetCases = {
+    {{"ab.c.", "a+b.", "^a.b.", "bc.$.", "[a-c]+"},
+     {"abc", "aab", "xabc", "abcx", "", "cab", "bc"}},
+    {{"Bf.o.o.B.", "fo.o.", "^fo.o..$.", "fo.o.ba.r.|"},
+     {"foo", "foobar", "a foo b", "bar", "xfoo", ""}},
+    {{"a*", "a#2-3", "^a#2.$.", "b?a.", "(ab|)+"},
+     {"", "a", "aa", "aaa", "ba", "bba", "c"}},
+};
+
+/* a{1} .. a{70}: more ids than one MatchSet word holds */
+static SetCase countedSet() {
+  SetCase t;
+  for (int k = 1; k <= 70; k++)
+    t.patterns.push_back("a#" + to_string(k));
+  t.inputs = {"", "b", string(5, 'a'), string(64, 'a'), string(70, 'a')};
+  return t;
+}
+
+static string describe(const MatchSet &set, size_t n) {
+  string out;
+  for (size_t i = 0; i < n; i++) {
+    if (set.contains(static_cast<ut32>(i)))
+      out += (out.empty() ? "" : " ") + to_string(i);
+  }
+  return out.empty() ? "none" : out;
+}
+
+static void checkSet(const char *engine, const char *call, const SetCase &t,
+                     const string &input, const MatchSet &want, bool ok,
+                     const MatchSet &got) {
+  checks++;
+  size_t n = t.patterns.size();
+  string w = describe(want, n), g = describe(got, n);
+  if (w == g && ok == !want.empty())
+    return;
+  failures++;
+  cout << "✗ " << engine << ' ' << call << ": patterns='";
+  for (size_t i = 0; i < n; i++)
+    cout << (i > 0 ? " " : "") << t.patterns[i];
+  cout << "' text='" << input << "'\n"
+       << "  Regex: " << w << "\n"
+       << "  " << engine << ": " << g << (ok ? " (match)" : " (no match)")
+       << "\n";
+}
+
+static void runRegexSet() {
+  size_t c0 = checks, f0 = failures;
+  vector<SetCase> cases = kSetCases;
+  cases.push_back(countedSet());
+  for (const SetCase &t : cases) {
+    vector<Regex> singles;
+    for (const string &p : t.patterns)
+      singles.emplace_back(p);
+    RegexSet dfa(t.patterns, true);
+    RegexSet nfa(t.patterns, false);
+
+    for (const string &s : t.inputs) {
+      MatchSet matched, found, got;
+      matched.reset(singles.size());
+      found.reset(singles.size());
+      for (size_t i = 0; i < singles.size(); i++) {
+        if (singles[i].match(s))
+          matched.insert(static_cast<ut32>(i));
+        if (singles[i].search(s))
+          found.insert(static_cast<ut32>(i));
+      }
+      bool ok = dfa.match(s, &got);
+      checkSet("RegexSet(dfa)", "match", t, s, matched, ok, got);
+      ok = nfa.match(s, &got);
+      checkSet("RegexSet(nfa)", "match", t, s, matched, ok, got);
+      ok = dfa.search(s, &got);
+      checkSet("RegexSet(dfa)", "search", t, s, found, ok, got);
+      ok = nfa.search(s, &got);
+      checkSet("RegexSet(nfa)", "search", t, s, found, ok, got);
+    }
+  }
+  section("RegexSet", c0, f0);
+}
+
+int main() {
+  cout << "=== NFA Engine Regression Suite ===\n";
+  cout << "Each engine against the Pike VM with the fast paths off\n\n";
+
+  runGlushkov();
+  runOnePass();
+  runBacktracker();
+  runFind();
+  runStreamMatcher();
+  runParallelScan();
+  runRegexSet();
+
+  cout << "\n========================================\n";
+  cout << "Results: " << checks - failures << "/" << checks << " passed, "
+       << failures << " failed\n";
+  cout << "========================================\n";
+  return failures == 0 ? 0 : 1;
+}
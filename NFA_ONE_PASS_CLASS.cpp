@@ -0,0 +1,127 @@
+#include "NFA.hpp"
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::GlushkovNFA GlushkovNFA;
+typedef PzRegex::OnePass OnePass;
+using PzRegex::lowestBit;
+
+static void setSlots(st64 *slots, ut64 mask, st64 pos) {
+  for (; mask; mask &= mask - 1)
+    slots[lowestBit(mask)] = pos;
+}
+
+// OnePass implementation
+// Byte classes come from splitting all 256 bytes by every position's
+// class in turn. A row is then filled from the position's consuming
+// edges; two of them wanting the same byte class means the pattern needs
+// more than one thread, and nothing is built.
+OnePass OnePass::fromProg(const Prog &prog) {
+  OnePass op;
+  const GlushkovNFA &g = prog.glushkov;
+  if (g.empty())
+    return op;
+
+  ut32 count = 1;
+  for (ut32 p = 1; p < g.size(); p++) {
+    const CharClass &cc = g.classOf(p);
+    std::vector<st32> split(2 * count, -1);
+    ut32 next = 0;
+    for (ut32 b = 0; b < 256; b++) {
+      ut32 key = 2 * op.byte_class_[b] +
+                 (cc.matches(static_cast<char>(b)) ? 1 : 0);
+      if (split[key] < 0)
+        split[key] = static_cast<st32>(next++);
+      op.byte_class_[b] = static_cast<ut8>(split[key]);
+    }
+    count = next;
+  }
+  if (static_cast<size_t>(g.size()) * count > kMaxCells)
+    return OnePass();
+  std::vector<ut32> member(count); // Byte class -> one byte in it
+  for (ut32 b = 256; b-- > 0;)
+    member[op.byte_class_[b]] = b;
+
+  op.classes_ = count;
+  op.width_ = static_cast<ut32>(2 * (prog.num_captures + 1));
+  op.table_.assign(static_cast<size_t>(g.size()) * count, kNoEdge);
+  for (ut32 p = 0; p < g.size(); p++) {
+    op.first_accept_.push_back(static_cast<ut32>(op.accepts_.size()));
+    ut32 *row = &op.table_[static_cast<size_t>(p) * count];
+    for (ut32 k = 0; k < g.edgeCount(p); k++) {
+      const GlushkovNFA::Edge &e = g.edges(p)[k];
+      ut32 index = static_cast<ut32>(op.edges_.size());
+      op.edges_.push_back(e);
+      if (e.to == GlushkovNFA::kAccept) {
+        op.accepts_.push_back(index);
+        continue;
+      }
+      const CharClass &cc = g.classOf(e.to);
+      for (ut32 c = 0; c < count; c++) {
+        if (!cc.matches(static_cast<char>(member[c])))
+          continue;
+        if (row[c] != kNoEdge)
+          return OnePass();
+        row[c] = index;
+      }
+    }
+  }
+  op.first_accept_.push_back(static_cast<ut32>(op.accepts_.size()));
+  return op;
+}
+
+// One thread, one pass. At each boundary the table gives the only edge
+// the next byte can take. A match reachable before that edge in priority
+// ends the run; one reachable after it is kept in case the run dies, as
+// the Pike VM keeps a lower-priority match until a better one replaces it.
+// With full set the match only counts at the end of s.
+bool OnePass::exec(std::string_view s, size_t at, bool full, st64 *slots,
+                   st64 *out, size_t *work) const {
+  std::fill_n(slots, width_, -1);
+  slots[width_ - 2] = static_cast<st64>(at);
+  bool matched = false;
+  ut32 p = 0;
+  for (size_t i = at;; i++) {
+    st32 prev = i > 0 ? static_cast<ut8>(s[i - 1]) : -1;
+    st32 next = i < s.length() ? static_cast<ut8>(s[i]) : -1;
+    ut32 take = kNoEdge;
+    if (next >= 0) {
+      take = table_[static_cast<size_t>(p) * classes_ + byte_class_[next]];
+      if (take != kNoEdge && edges_[take].asserts &&
+          !GlushkovNFA::holds(edges_[take].asserts, prev, next))
+        take = kNoEdge;
+    }
+
+    if (!full || next < 0) {
+      for (ut32 k = first_accept_[p]; k < first_accept_[p + 1]; k++) {
+        const GlushkovNFA::Edge &e = edges_[accepts_[k]];
+        if (e.asserts && !GlushkovNFA::holds(e.asserts, prev, next))
+          continue;
+        std::copy_n(slots, width_, out);
+        setSlots(out, e.slots, static_cast<st64>(i));
+        out[width_ - 1] = static_cast<st64>(i);
+        matched = true;
+        if (take == kNoEdge || accepts_[k] < take)
+          return true;
+        break;
+      }
+    }
+
+    if (take == kNoEdge)
+      return matched;
+    setSlots(slots, edges_[take].slots, static_cast<st64>(i));
+    p = edges_[take].to;
+    ++*work;
+  }
+}
+
+bool OnePass::empty() const { return table_.empty(); }
+
+ut32 OnePass::width() const { return width_; }
+
+size_t OnePass::bytes() const {
+  return table_.capacity() * sizeof(ut32) +
+         edges_.capacity() * sizeof(GlushkovNFA::Edge) +
+         first_accept_.capacity() * sizeof(ut32) +
+         accepts_.capacity() * sizeof(ut32);
+}
@@ -0,0 +1,95 @@
+#include "NFA.hpp"
+
+typedef PzRegex::Prog Prog;
+typedef PzRegex::LazyDFA LazyDFA;
+typedef PzRegex::WorkPool WorkPool;
+typedef PzRegex::MatchSet MatchSet;
+typedef PzRegex::ParallelScan ParallelScan;
+
+// ParallelScan implementation
+ParallelScan::ParallelScan(std::shared_ptr<const Prog> prog, size_t minChunk,
+                           size_t lookback)
+    : prog_(std::move(prog)), min_chunk_(std::max<size_t>(minChunk, 1)),
+      lookback_(lookback) {}
+
+bool ParallelScan::find(std::string_view s, size_t *end,
+                        WorkPool *pool) const {
+  const size_t npos = std::string_view::npos;
+  size_t n = s.length();
+  if (n == 0) {
+    LazyDFA dfa(prog_, 4096, true);
+    MatchSet ids;
+    bool found = dfa.matchAll(s, false, &ids);
+    if (found && end)
+      *end = 0;
+    return found;
+  }
+  if (!pool)
+    pool = &WorkPool::shared();
+
+  size_t chunks = std::max<size_t>(1, std::min(n / min_chunk_, 4 * pool->size()));
+  size_t chunk = (n + chunks - 1) / chunks;
+  chunks = (n + chunk - 1) / chunk;
+  size_t every = std::max<size_t>(4096, chunk / 64);
+  std::vector<LazyDFA::ScanTrace> traces(chunks);
+
+  // Speculative pass: every chunk guesses its entry state from the bytes
+  // just before it and records where it goes from there.
+  pool->parallelFor(chunks, [&](size_t begin, size_t stop) {
+    LazyDFA dfa(prog_, 4096, true);
+    LazyDFA::StateKey start = dfa.startKey(false);
+    LazyDFA::ScanTrace guess;
+    for (size_t i = begin; i < stop; i++) {
+      size_t at = i * chunk;
+      size_t len = std::min(chunk, n - at);
+      LazyDFA::StateKey entry = start;
+      if (at > 0 && lookback_ > 0) {
+        size_t from = at > lookback_ ? at - lookback_ : 0;
+        dfa.trace(s.substr(from, at - from), start, at - from, false, &guess);
+        entry = guess.keys.back();
+      }
+      dfa.trace(s.substr(at, len), entry, every, at + len == n, &traces[i]);
+    }
+  });
+
+  // Serial fix-up: chain chunks in order, re-running a chunk from its real
+  // entry state only until it meets its own recorded run.
+  LazyDFA fix(prog_, 4096, true);
+  LazyDFA::StateKey truth = fix.startKey(false);
+  LazyDFA::ScanTrace redo;
+  for (size_t i = 0; i < chunks; i++) {
+    const LazyDFA::ScanTrace &t = traces[i];
+    size_t at = i * chunk;
+    size_t len = std::min(chunk, n - at);
+    size_t k = 0; // First stretch whose recorded result holds
+    if (t.keys[0] != truth) {
+      for (; k < t.first.size(); k++) {
+        size_t from = k * every;
+        size_t stop = std::min(len, from + every);
+        fix.trace(s.substr(at + from, stop - from), truth, every,
+                  at + stop == n, &redo);
+        if (redo.first[0] != npos) {
+          if (end)
+            *end = at + from + redo.first[0];
+          return true;
+        }
+        truth = redo.keys.back();
+        if (truth == t.keys[k + 1]) {
+          k++;
+          break;
+        }
+      }
+      if (k == t.first.size())
+        continue; // Re-run to the end; truth is its exit state
+    }
+    for (; k < t.first.size(); k++) {
+      if (t.first[k] != npos) {
+        if (end)
+          *end = at + t.first[k];
+        return true;
+      }
+    }
+    truth = t.keys.back();
+  }
+  return false;
+}
@@ -0,0 +1,469 @@
+#include "NFA.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define PZ_PREFILTER_SSE2 1
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define PZ_PREFILTER_SSSE3 1
+#define PZ_PREFILTER_SSSE3_TARGET
+#elif defined(PZ_PREFILTER_SSE2) && defined(__GNUC__)
+#define PZ_PREFILTER_SSSE3 1
+#define PZ_PREFILTER_SSSE3_DISPATCH 1 // CPU checked at run time
+#define PZ_PREFILTER_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::PrefilterType PrefilterType;
+typedef PzRegex::Prefilter Prefilter;
+using PzRegex::lowestBit;
+
+#if defined(PZ_PREFILTER_SSSE3)
+static bool hasSsse3() {
+#if defined(PZ_PREFILTER_SSSE3_DISPATCH)
+  static const bool has = __builtin_cpu_supports("ssse3");
+  return has;
+#else
+  return true;
+#endif
+}
+#endif
+
+// The only byte of cc, or -1 when it has none or several
+static st32 soleByte(const PzRegex::CharClass &cc) {
+  st32 found = -1;
+  for (ut32 b = 0; b < 256; b++) {
+    if (!cc.matches(static_cast<char>(b)))
+      continue;
+    if (found >= 0)
+      return -1;
+    found = static_cast<st32>(b);
+  }
+  return found;
+}
+
+// Members of cc in byte order, or false when it has none or too many
+static bool classBytes(const PzRegex::CharClass &cc, size_t limit,
+                       std::string *out) {
+  out->clear();
+  for (ut32 b = 0; b < 256; b++) {
+    if (!cc.matches(static_cast<char>(b)))
+      continue;
+    if (out->size() == limit)
+      return false;
+    out->push_back(static_cast<char>(b));
+  }
+  return !out->empty();
+}
+
+// Offset of the first b in p[0, n), or n.
+static size_t findByte(const char *p, size_t n, char b) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i nb32 = _mm256_set1_epi8(b);
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    ut32 m = static_cast<ut32>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nb32)));
+    if (m)
+      return i + lowestBit(m);
+  }
+#endif
+#if defined(PZ_PREFILTER_SSE2)
+  const __m128i nb16 = _mm_set1_epi8(b);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    ut32 m = static_cast<ut32>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nb16)));
+    if (m)
+      return i + lowestBit(m);
+  }
+#endif
+  const void *hit = std::memchr(p + i, b, n - i);
+  return hit ? static_cast<const char *>(hit) - p : n;
+}
+
+// Offset of the first occurrence of lit (at least 2 bytes) in p[0, n), or
+// n. Vector blocks compare the first and the last byte of lit at once and
+// only the surviving offsets are checked with memcmp.
+static size_t findLiteral(const char *p, size_t n, const std::string &lit) {
+  size_t k = lit.size();
+  if (k > n)
+    return n;
+  size_t last = n - k; // Last possible start
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i first32 = _mm256_set1_epi8(lit[0]);
+  const __m256i final32 = _mm256_set1_epi8(lit[k - 1]);
+  for (; i + 32 <= last + 1; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    __m256i z = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(p + i + k - 1));
+    ut32 m = static_cast<ut32>(_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(a, first32), _mm256_cmpeq_epi8(z, final32))));
+    while (m) {
+      size_t at = i + lowestBit(m);
+      if (std::memcmp(p + at + 1, lit.data() + 1, k - 2) == 0)
+        return at;
+      m &= m - 1;
+    }
+  }
+#endif
+#if defined(PZ_PREFILTER_SSE2)
+  const __m128i first16 = _mm_set1_epi8(lit[0]);
+  const __m128i final16 = _mm_set1_epi8(lit[k - 1]);
+  for (; i + 16 <= last + 1; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i z =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + k - 1));
+    ut32 m = static_cast<ut32>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, first16), _mm_cmpeq_epi8(z, final16))));
+    while (m) {
+      size_t at = i + lowestBit(m);
+      if (std::memcmp(p + at + 1, lit.data() + 1, k - 2) == 0)
+        return at;
+      m &= m - 1;
+    }
+  }
+#endif
+  while (i <= last) {
+    size_t at = i + findByte(p + i, last + 1 - i, lit[0]);
+    if (at > last)
+      break;
+    if (std::memcmp(p + at + 1, lit.data() + 1, k - 1) == 0)
+      return at;
+    i = at + 1;
+  }
+  return n;
+}
+
+// Prefilter implementation
+Prefilter::Prefilter() : type_(PrefilterType::PREFILTER_NONE) {}
+
+Prefilter Prefilter::fromProg(const Prog &prog) {
+  struct Path {
+    ut32 pc;            // Next instruction
+    std::string prefix; // Bytes consumed so far
+  };
+
+  Prefilter pf;
+  std::vector<std::string> lits;
+  std::vector<ut8> seen(prog.size(), 0); // Splits expanded with no prefix
+  std::vector<Path> stack;
+  std::string members;
+  stack.push_back({prog.start, std::string()});
+
+  // Leading splits fork the walk; any other branch point ends the literal.
+  // A path that reaches a class or the match without a byte means there is
+  // no required prefix at all.
+  while (!stack.empty()) {
+    Path path = std::move(stack.back());
+    stack.pop_back();
+    for (;;) {
+      const Inst &inst = prog.insts[path.pc];
+      StateType t = inst.type();
+      if (t == StateType::STATE_CHAR) {
+        path.prefix += static_cast<char>(inst.arg);
+        if (path.prefix.size() == kMaxLiteralLen) {
+          lits.push_back(std::move(path.prefix));
+          break;
+        }
+        path.pc = inst.out;
+      } else if (t == StateType::STATE_REPEAT &&
+                 prog.repeats[inst.arg].min > 0 &&
+                 soleByte(prog.classes[prog.repeats[inst.arg].cls]) >= 0) {
+        // b{n,m}: n copies of b are required, any more are optional
+        const Prog::Repeat &r = prog.repeats[inst.arg];
+        size_t n = std::min<size_t>(r.min, kMaxLiteralLen - path.prefix.size());
+        path.prefix.append(n, static_cast<char>(soleByte(prog.classes[r.cls])));
+        if (r.max != r.min || path.prefix.size() == kMaxLiteralLen) {
+          lits.push_back(std::move(path.prefix));
+          break;
+        }
+        path.pc = inst.out;
+      } else if (t == StateType::STATE_CHARCLASS && path.prefix.empty() &&
+                 classBytes(prog.classes[inst.arg], kMaxClassFanout,
+                            &members) &&
+                 stack.size() + lits.size() + members.size() <=
+                     kMaxClassPaths) {
+        // A small leading class forks like a split, once per member, so
+        // the [abc] that a|b|c was folded into still yields its literals
+        for (size_t k = 1; k < members.size(); k++)
+          stack.push_back({inst.out, std::string(1, members[k])});
+        path.prefix = members.substr(0, 1);
+        path.pc = inst.out;
+      } else if (t == StateType::STATE_ASSERTION ||
+                 t == StateType::STATE_CAPTURE_START ||
+                 t == StateType::STATE_CAPTURE_END) {
+        path.pc = inst.out;
+      } else if (t == StateType::STATE_SPLIT && path.prefix.empty()) {
+        if (seen[path.pc])
+          break;
+        seen[path.pc] = 1;
+        stack.push_back({inst.out1, std::string()});
+        path.pc = inst.out;
+      } else {
+        if (path.prefix.empty())
+          return pf;
+        lits.push_back(std::move(path.prefix));
+        break;
+      }
+      if (path.pc == Prog::kNone)
+        return pf;
+    }
+    if (lits.size() > kMaxLiterals)
+      return pf;
+  }
+  if (lits.empty())
+    return pf;
+
+  // A literal that extends another one adds no candidates.
+  std::sort(lits.begin(), lits.end());
+  for (std::string &lit : lits) {
+    const std::string *prev =
+        pf.literals_.empty() ? nullptr : &pf.literals_.back();
+    if (prev && lit.compare(0, prev->size(), *prev) == 0)
+      continue;
+    pf.literals_.push_back(std::move(lit));
+  }
+
+  pf.min_len_ = pf.max_len_ = pf.literals_[0].size();
+  for (const std::string &lit : pf.literals_) {
+    pf.min_len_ = std::min(pf.min_len_, lit.size());
+    pf.max_len_ = std::max(pf.max_len_, lit.size());
+  }
+
+  if (pf.literals_.size() == 1) {
+    pf.type_ = pf.min_len_ == 1 ? PrefilterType::PREFILTER_BYTE
+                                : PrefilterType::PREFILTER_LITERAL;
+  } else if (pf.literals_.size() <= kTeddyMaxLiterals) {
+    pf.type_ = PrefilterType::PREFILTER_TEDDY;
+    pf.buildTeddy();
+  } else {
+    pf.type_ = PrefilterType::PREFILTER_AHO_CORASICK;
+    pf.buildAhoCorasick();
+  }
+  return pf;
+}
+
+void Prefilter::buildTeddy() {
+  teddy_len_ = static_cast<ut32>(
+      std::min<size_t>(min_len_, kTeddyMaxFingerprint));
+  teddy_masks_.assign(teddy_len_ * 32, 0);
+  buckets_.assign(kTeddyBuckets, std::vector<ut32>());
+
+  for (ut32 i = 0; i < literals_.size(); i++) {
+    ut32 b = i % kTeddyBuckets;
+    ut8 bit = static_cast<ut8>(1u << b);
+    buckets_[b].push_back(i);
+    for (ut32 j = 0; j < teddy_len_; j++) {
+      ut8 c = static_cast<ut8>(literals_[i][j]);
+      teddy_masks_[j * 32 + (c & 15)] |= bit;
+      teddy_masks_[j * 32 + 16 + (c >> 4)] |= bit;
+    }
+    teddy_first_[static_cast<ut8>(literals_[i][0])] |= bit;
+  }
+}
+
+void Prefilter::buildAhoCorasick() {
+  // Bytes that appear in no literal share class 0.
+  std::array<bool, 256> used = {};
+  ut32 distinct = 0;
+  for (const std::string &lit : literals_) {
+    for (char c : lit) {
+      ut8 b = static_cast<ut8>(c);
+      distinct += used[b] ? 0 : 1;
+      used[b] = true;
+    }
+  }
+  ac_stride_ = 1;
+  for (ut32 b = 0; b < 256; b++) {
+    if (distinct < 256 && used[b])
+      ac_class_[b] = static_cast<ut8>(ac_stride_++);
+    else if (distinct == 256)
+      ac_class_[b] = static_cast<ut8>(b);
+  }
+  if (distinct == 256)
+    ac_stride_ = 256;
+
+  // Trie; missing edges are kNone until the BFS below fills them in.
+  ac_delta_.assign(ac_stride_, Prog::kNone);
+  ac_out_.assign(1, 0);
+  for (const std::string &lit : literals_) {
+    ut32 node = 0;
+    for (char c : lit) {
+      ut32 &next = ac_delta_[node * ac_stride_ + ac_class_[static_cast<ut8>(c)]];
+      if (next == Prog::kNone) {
+        next = static_cast<ut32>(ac_out_.size());
+        ac_out_.push_back(0);
+        ac_delta_.resize(ac_delta_.size() + ac_stride_, Prog::kNone);
+      }
+      node = ac_delta_[node * ac_stride_ + ac_class_[static_cast<ut8>(c)]];
+    }
+    ac_out_[node] = static_cast<ut32>(lit.size());
+  }
+
+  // Breadth-first failure links folded into a complete transition table.
+  std::vector<ut32> fail(ac_out_.size(), 0);
+  std::vector<ut32> queue;
+  for (ut32 c = 0; c < ac_stride_; c++) {
+    ut32 &next = ac_delta_[c];
+    if (next == Prog::kNone) {
+      next = 0;
+    } else {
+      fail[next] = 0;
+      queue.push_back(next);
+    }
+  }
+  for (size_t qi = 0; qi < queue.size(); qi++) {
+    ut32 u = queue[qi];
+    ac_out_[u] = std::max(ac_out_[u], ac_out_[fail[u]]);
+    for (ut32 c = 0; c < ac_stride_; c++) {
+      ut32 &next = ac_delta_[u * ac_stride_ + c];
+      ut32 via_fail = ac_delta_[fail[u] * ac_stride_ + c];
+      if (next == Prog::kNone) {
+        next = via_fail;
+      } else {
+        fail[next] = via_fail;
+        queue.push_back(next);
+      }
+    }
+  }
+}
+
+bool Prefilter::verifyBuckets(const char *p, size_t n, size_t at,
+                              ut32 buckets) const {
+  while (buckets) {
+    ut32 b = lowestBit(buckets);
+    buckets &= buckets - 1;
+    for (ut32 li : buckets_[b]) {
+      const std::string &lit = literals_[li];
+      if (at + lit.size() <= n &&
+          std::memcmp(p + at, lit.data(), lit.size()) == 0)
+        return true;
+    }
+  }
+  return false;
+}
+
+#if defined(PZ_PREFILTER_SSSE3)
+// Each fingerprint byte selects its buckets through two 16-entry nibble
+// lookups; a bucket bit that survives all of them marks a candidate.
+// Without -mssse3 this is built for SSSE3 alone and only runs when the
+// CPU has it. *from is left where the scalar loop must carry on.
+PZ_PREFILTER_SSSE3_TARGET
+size_t Prefilter::findTeddyBlocks(const char *p, size_t n,
+                                  size_t *from) const {
+  size_t i = *from;
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  __m128i lo[kTeddyMaxFingerprint], hi[kTeddyMaxFingerprint];
+  for (ut32 j = 0; j < teddy_len_; j++) {
+    lo[j] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(teddy_masks_.data() + j * 32));
+    hi[j] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(teddy_masks_.data() + j * 32 + 16));
+  }
+  for (; i + 16 + teddy_len_ - 1 <= n; i += 16) {
+    __m128i res = _mm_set1_epi8(static_cast<char>(0xFF));
+    for (ut32 j = 0; j < teddy_len_; j++) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + j));
+      __m128i l = _mm_shuffle_epi8(lo[j], _mm_and_si128(v, nibble));
+      __m128i h = _mm_shuffle_epi8(
+          hi[j], _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+      res = _mm_and_si128(res, _mm_and_si128(l, h));
+    }
+    ut32 m = ~static_cast<ut32>(_mm_movemask_epi8(
+                 _mm_cmpeq_epi8(res, _mm_setzero_si128()))) &
+             0xFFFF;
+    if (!m)
+      continue;
+    alignas(16) ut8 lanes[16];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), res);
+    while (m) {
+      ut32 k = lowestBit(m);
+      m &= m - 1;
+      if (verifyBuckets(p, n, i + k, lanes[k]))
+        return i + k;
+    }
+  }
+  *from = i;
+  return npos;
+}
+#endif
+
+size_t Prefilter::findTeddy(const char *p, size_t n) const {
+  size_t i = 0;
+#if defined(PZ_PREFILTER_SSSE3)
+  if (hasSsse3()) {
+    size_t at = findTeddyBlocks(p, n, &i);
+    if (at != npos)
+      return at;
+  }
+#endif
+  for (; i < n; i++) {
+    ut8 buckets = teddy_first_[static_cast<ut8>(p[i])];
+    if (buckets && verifyBuckets(p, n, i, buckets))
+      return i;
+  }
+  return n;
+}
+
+size_t Prefilter::findAhoCorasick(const char *p, size_t n) const {
+  // Matches are reported by end offset; keep going until no literal that
+  // starts before the best one so far can still end.
+  size_t best = n;
+  ut32 state = 0;
+  for (size_t i = 0; i < n; i++) {
+    state = ac_delta_[state * ac_stride_ + ac_class_[static_cast<ut8>(p[i])]];
+    if (ac_out_[state])
+      best = std::min(best, i + 1 - ac_out_[state]);
+    if (best != n && i + 1 >= best + max_len_)
+      break;
+  }
+  return best;
+}
+
+PrefilterType Prefilter::type() const { return type_; }
+
+bool Prefilter::empty() const { return type_ == PrefilterType::PREFILTER_NONE; }
+
+const std::vector<std::string> &Prefilter::literals() const {
+  return literals_;
+}
+
+size_t Prefilter::bytes() const {
+  size_t n = literals_.capacity() * sizeof(std::string) +
+             teddy_masks_.capacity() + ac_delta_.capacity() * sizeof(ut32) +
+             ac_out_.capacity() * sizeof(ut32);
+  for (const std::string &lit : literals_)
+    n += lit.capacity();
+  for (const std::vector<ut32> &b : buckets_)
+    n += sizeof(b) + b.capacity() * sizeof(ut32);
+  return n;
+}
+
+size_t Prefilter::find(std::string_view s, size_t from) const {
+  if (from > s.length())
+    return npos;
+  const char *p = s.data() + from;
+  size_t n = s.length() - from;
+  size_t at;
+  switch (type_) {
+  case PrefilterType::PREFILTER_BYTE:
+    at = findByte(p, n, literals_[0][0]);
+    break;
+  case PrefilterType::PREFILTER_LITERAL:
+    at = findLiteral(p, n, literals_[0]);
+    break;
+  case PrefilterType::PREFILTER_TEDDY:
+    at = findTeddy(p, n);
+    break;
+  case PrefilterType::PREFILTER_AHO_CORASICK:
+    at = findAhoCorasick(p, n);
+    break;
+  default:
+    return from;
+  }
+  return at == n ? npos : from + at;
+}
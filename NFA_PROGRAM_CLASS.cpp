@@ -0,0 +1,259 @@
+#include "NFA.hpp"
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::State State;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::Prog::Repeat Repeat;
+typedef PzRegex::NFABuilder NFABuilder;
+
+static_assert(sizeof(Inst) == 16, "Inst is meant to stay 16 bytes");
+
+// Prog implementation
+Prog Prog::compile(State *start, State *match, st32 numCaptures,
+                   const std::vector<CharClass> &classes) {
+  Prog prog = compileBody(start, match, numCaptures, classes);
+  appendUnanchored(prog);
+  prog.glushkov = PzRegex::GlushkovNFA::fromProg(prog);
+  prog.onepass = PzRegex::OnePass::fromProg(prog);
+  return prog;
+}
+
+Prog Prog::compileBody(State *start, State *match, st32 numCaptures,
+                       const std::vector<CharClass> &classes) {
+  Prog prog;
+  prog.num_captures = numCaptures;
+  prog.classes = classes;
+
+  // Number every reachable state; depth-first so the start gets index 0.
+  std::unordered_map<State *, ut32> index;
+  std::vector<State *> order;
+  std::vector<State *> stack;
+  stack.push_back(start);
+  while (!stack.empty()) {
+    State *s = stack.back();
+    stack.pop_back();
+    if (!s || index.count(s))
+      continue;
+    index.emplace(s, static_cast<ut32>(order.size()));
+    order.push_back(s);
+    stack.push_back(s->out1);
+    stack.push_back(s->out);
+  }
+
+  auto indexOf = [&](State *s) -> ut32 {
+    return s ? index.at(s) : kNone;
+  };
+
+  prog.insts.resize(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    State *s = order[i];
+    Inst &inst = prog.insts[i];
+    inst.op = static_cast<ut8>(s->type);
+    inst.greedy = s->greedy ? 1 : 0;
+    inst.pad = 0;
+    inst.arg = 0;
+    inst.out = indexOf(s->out);
+    inst.out1 = indexOf(s->out1);
+
+    switch (s->type) {
+    case StateType::STATE_CHAR:
+      inst.arg = static_cast<ut8>(static_cast<char>(s->c));
+      break;
+    case StateType::STATE_CHARCLASS:
+      inst.arg = s->classIndex;
+      break;
+    case StateType::STATE_ASSERTION:
+      inst.arg = static_cast<st32>(s->assertion);
+      break;
+    case StateType::STATE_CAPTURE_START:
+    case StateType::STATE_CAPTURE_END:
+      inst.arg = s->captureIndex;
+      break;
+    case StateType::STATE_REPEAT: {
+      Repeat r;
+      r.pc = static_cast<ut32>(i);
+      r.cls = s->classIndex;
+      r.min = static_cast<ut32>(s->repeatMin);
+      r.max = s->repeatMax < 0 ? kNone : static_cast<ut32>(s->repeatMax);
+      r.base = prog.count_ids;
+      prog.count_ids += r.max == kNone ? r.min : r.max;
+      inst.arg = static_cast<st32>(prog.repeats.size());
+      prog.repeats.push_back(r);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  prog.start = indexOf(start);
+  auto it = index.find(match);
+  prog.match = it == index.end() ? kNone : it->second;
+  return prog;
+}
+
+// Unanchored entry: loop: split(any -> loop, span -> start), preferring
+// the span side so earlier start positions keep the higher priority.
+void Prog::appendUnanchored(Prog &prog) {
+  ut32 span = prog.size();
+  ut32 loop = span + 1;
+  ut32 any = span + 2;
+  Inst inst = {};
+  inst.op = static_cast<ut8>(StateType::STATE_CAPTURE_START);
+  inst.arg = prog.num_captures;
+  inst.out = prog.start;
+  inst.out1 = kNone;
+  prog.insts.push_back(inst);
+
+  inst.op = static_cast<ut8>(StateType::STATE_SPLIT);
+  inst.greedy = 0;
+  inst.arg = 0;
+  inst.out = any;
+  inst.out1 = span;
+  prog.insts.push_back(inst);
+
+  CharClass anyByte;
+  anyByte.negate();
+  auto any_it = std::find(prog.classes.begin(), prog.classes.end(), anyByte);
+  inst.op = static_cast<ut8>(StateType::STATE_CHARCLASS);
+  inst.greedy = 1;
+  inst.arg = static_cast<st32>(any_it - prog.classes.begin());
+  inst.out = loop;
+  inst.out1 = kNone;
+  if (any_it == prog.classes.end())
+    prog.classes.push_back(anyByte);
+  prog.insts.push_back(inst);
+
+  prog.unanchored = loop;
+  prog.prefilter = PzRegex::Prefilter::fromProg(prog);
+}
+
+Prog Prog::join(const std::vector<Prog> &progs) {
+  Prog set;
+  set.match = kNone;
+  if (progs.empty()) {
+    // Nothing can match: a lone class with no bytes in it
+    Inst none = {};
+    none.op = static_cast<ut8>(StateType::STATE_CHARCLASS);
+    none.out = none.out1 = kNone;
+    set.classes.push_back(CharClass());
+    set.insts.push_back(none);
+    appendUnanchored(set);
+    return set;
+  }
+
+  // Root: split chain fanning out to every pattern, pattern i below split i
+  ut32 roots = static_cast<ut32>(progs.size()) - 1;
+  set.insts.resize(roots);
+  std::vector<ut32> starts;
+  std::map<std::array<ut64, 4>, st32> class_ids; // Shared class table
+  std::vector<st32> class_map;
+  for (size_t id = 0; id < progs.size(); id++) {
+    const Prog &p = progs[id];
+    ut32 base = set.size();
+    class_map.clear();
+    for (const CharClass &cc : p.classes) {
+      auto ins = class_ids.emplace(cc.bits, static_cast<st32>(set.classes.size()));
+      if (ins.second)
+        set.classes.push_back(cc);
+      class_map.push_back(ins.first->second);
+    }
+    for (Inst inst : p.insts) {
+      if (inst.out != kNone)
+        inst.out += base;
+      if (inst.out1 != kNone)
+        inst.out1 += base;
+      switch (inst.type()) {
+      case StateType::STATE_CHARCLASS:
+        inst.arg = class_map[inst.arg];
+        break;
+      case StateType::STATE_CAPTURE_START:
+      case StateType::STATE_CAPTURE_END:
+        inst.arg = -1; // Sets do not report captures
+        break;
+      case StateType::STATE_MATCH:
+        inst.arg = static_cast<st32>(id);
+        break;
+      case StateType::STATE_REPEAT:
+        inst.arg += static_cast<st32>(set.repeats.size());
+        break;
+      default:
+        break;
+      }
+      set.insts.push_back(inst);
+    }
+    for (Repeat r : p.repeats) {
+      r.pc += base;
+      r.cls = class_map[r.cls];
+      r.base += set.count_ids;
+      set.repeats.push_back(r);
+    }
+    set.count_ids += p.count_ids;
+    starts.push_back(base + p.start);
+  }
+
+  for (ut32 i = 0; i < roots; i++) {
+    Inst &split = set.insts[i];
+    split = {};
+    split.op = static_cast<ut8>(StateType::STATE_SPLIT);
+    split.greedy = 1;
+    split.out = starts[i];
+    split.out1 = i + 1 < roots ? i + 1 : starts[i + 1];
+  }
+  set.start = roots > 0 ? 0 : starts[0];
+  appendUnanchored(set);
+  set.glushkov = PzRegex::GlushkovNFA::fromProg(set);
+  set.onepass = PzRegex::OnePass::fromProg(set);
+  return set;
+}
+
+ut32 Prog::size() const { return static_cast<ut32>(insts.size()); }
+
+size_t Prog::bytes() const {
+  return sizeof(Prog) + insts.capacity() * sizeof(Inst) +
+         classes.capacity() * sizeof(CharClass) +
+         repeats.capacity() * sizeof(Repeat) + prefilter.bytes() +
+         glushkov.bytes() + onepass.bytes() +
+         (reverse ? reverse->bytes() : 0);
+}
+
+ut32 Prog::ids() const { return size() + count_ids; }
+
+ut32 Prog::pcOf(ut32 id, ut32 *count) const {
+  if (id < size()) {
+    if (count)
+      *count = 0;
+    return id;
+  }
+  ut32 k = id - size();
+  auto it = std::upper_bound(
+      repeats.begin(), repeats.end(), k,
+      [](ut32 v, const Repeat &r) { return v < r.base; });
+  const Repeat &r = *--it;
+  if (count)
+    *count = k - r.base + 1;
+  return r.pc;
+}
+
+ut32 Prog::advance(ut32 id) const {
+  ut32 count;
+  ut32 pc = pcOf(id, &count);
+  const Repeat &r = repeats[insts[pc].arg];
+  ut32 next = count + 1;
+  if (r.max == kNone)
+    next = std::min(next, r.min);
+  else if (next > r.max)
+    return kNone;
+  return next == 0 ? pc : size() + r.base + next - 1;
+}
+
+// NFABuilder lowering
+Prog NFABuilder::compile(State *start) const {
+  return Prog::compile(start, matchstate_, next_capture_index_, classes_);
+}
+
+Prog NFABuilder::compileBody(State *start) const {
+  return Prog::compileBody(start, matchstate_, next_capture_index_, classes_);
+}
@@ -0,0 +1,84 @@
+#include "NFA.hpp"
+
+typedef PzRegex::Regex Regex;
+typedef PzRegex::RegexCache RegexCache;
+
+// Bookkeeping per entry besides the program: list node, index slot, key
+static constexpr size_t kEntryOverhead = 96;
+
+// RegexCache implementation
+RegexCache::RegexCache(size_t budget) : budget_(budget) {}
+
+RegexCache &RegexCache::shared() {
+  static RegexCache cache;
+  return cache;
+}
+
+Regex RegexCache::get(std::string_view pattern, ut32 flags) {
+  std::string key(1, static_cast<char>(flags));
+  key.append(pattern);
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      stats_.hits++;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->regex;
+    }
+    stats_.misses++;
+  }
+
+  Regex regex = flags & FLAG_POSTFIX ? Regex(std::string(pattern))
+                                     : Regex::parse(pattern);
+  size_t bytes = regex.prog().bytes() + key.capacity() + kEntryOverhead;
+
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    // Another thread compiled it meanwhile; hand out the cached copy
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->regex;
+  }
+  lru_.push_front(Entry{std::move(key), regex, bytes});
+  index_.emplace(lru_.front().key, lru_.begin());
+  stats_.bytes += bytes;
+  trim();
+  return regex;
+}
+
+// An entry over the whole budget is evicted at once; its caller still
+// gets the compiled Regex.
+void RegexCache::trim() {
+  while (stats_.bytes > budget_ && !lru_.empty()) {
+    Entry &victim = lru_.back();
+    stats_.bytes -= victim.bytes;
+    stats_.evictions++;
+    index_.erase(victim.key);
+    lru_.pop_back();
+  }
+}
+
+void RegexCache::set_budget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mu_);
+  budget_ = bytes;
+  trim();
+}
+
+size_t RegexCache::budget() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return budget_;
+}
+
+RegexCache::Stats RegexCache::stats() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  Stats s = stats_;
+  s.entries = lru_.size();
+  return s;
+}
+
+void RegexCache::clear() {
+  std::lock_guard<std::mutex> lock(mu_);
+  index_.clear();
+  lru_.clear();
+  stats_ = Stats();
+}
@@ -0,0 +1,156 @@
+#include "NFA.hpp"
+
+typedef PzRegex::State State;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::NFABuilder NFABuilder;
+typedef PzRegex::NFASimulator NFASimulator;
+typedef PzRegex::MatchSpan MatchSpan;
+typedef PzRegex::MatchSet MatchSet;
+typedef PzRegex::WorkPool WorkPool;
+typedef PzRegex::Regex Regex;
+
+namespace {
+// Per-thread scratch, one simulator per regex id. The last hit is cached
+// so the common one-pattern-per-thread loop skips the map lookup.
+struct ScratchPool {
+  struct Entry {
+    std::weak_ptr<const Prog> prog;     // Detects regexes that are gone
+    std::unique_ptr<NFASimulator> sim;  // Scratch for that program
+  };
+
+  static constexpr size_t kSweepAt = 64; // Entries before dead ones go
+
+  ut64 last_id = 0;
+  NFASimulator *last = nullptr;
+  std::unordered_map<ut64, Entry> entries;
+  size_t sweep_at = kSweepAt;
+
+  NFASimulator &get(ut64 id, const std::shared_ptr<const Prog> &prog) {
+    if (last && last_id == id)
+      return *last;
+
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+      if (entries.size() >= sweep_at)
+        sweep();
+      // The scratch borrows the program (empty owner) so a dropped regex
+      // is seen as an expired weak_ptr.
+      Entry e;
+      e.prog = prog;
+      e.sim = std::make_unique<NFASimulator>(
+          std::shared_ptr<const Prog>(std::shared_ptr<const Prog>(), prog.get()));
+      it = entries.emplace(id, std::move(e)).first;
+    }
+    last_id = id;
+    last = it->second.sim.get();
+    return *last;
+  }
+
+  // Drop scratch of regexes that no longer exist.
+  void sweep() {
+    for (auto it = entries.begin(); it != entries.end();) {
+      if (it->second.prog.expired()) {
+        if (it->second.sim.get() == last)
+          last = nullptr;
+        it = entries.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    sweep_at = std::max(kSweepAt, 2 * entries.size());
+  }
+};
+
+thread_local ScratchPool t_scratch;
+std::atomic<ut64> g_next_id{1};
+} // namespace
+
+// Regex implementation
+// The reversed program gets a builder of its own. It only serves find(),
+// which runs it anchored from start, so it stops at compileBody(): no
+// unanchored entry, prefilter or engine tables.
+static std::shared_ptr<const Prog> compilePostfix(const std::string &postfix) {
+  NFABuilder builder, mirror;
+  Prog prog = builder.compile(builder.build(postfix));
+  prog.reverse = std::make_shared<const Prog>(
+      mirror.compileBody(mirror.build(postfix, true)));
+  return std::make_shared<const Prog>(std::move(prog));
+}
+
+Regex::Regex(const std::string &postfix) : Regex(compilePostfix(postfix)) {}
+
+Regex Regex::parse(std::string_view pattern) {
+  NFABuilder builder, mirror;
+  Prog prog = builder.compile(builder.parse(pattern));
+  prog.reverse = std::make_shared<const Prog>(
+      mirror.compileBody(mirror.parse(pattern, true)));
+  return Regex(std::make_shared<const Prog>(std::move(prog)));
+}
+
+Regex::Regex(std::shared_ptr<const Prog> prog)
+    : prog_(std::move(prog)), id_(g_next_id.fetch_add(1)) {}
+
+const Prog &Regex::prog() const { return *prog_; }
+
+ut64 Regex::id() const { return id_; }
+
+NFASimulator &Regex::scratch() const { return t_scratch.get(id_, prog_); }
+
+bool Regex::match(std::string_view s) const { return scratch().match(s); }
+
+bool Regex::search(std::string_view s, MatchSpan *span, size_t from) const {
+  NFASimulator &sim = scratch();
+  bool found = sim.search(s, from);
+  if (span)
+    *span = sim.get_match_span();
+  return found;
+}
+
+bool Regex::find(std::string_view s, MatchSpan *span, size_t from) const {
+  NFASimulator &sim = scratch();
+  bool found = sim.find(s, from);
+  if (span)
+    *span = sim.get_match_span();
+  return found;
+}
+
+// Records are scheduled in blocks of 64 so each task owns whole words of
+// the result bitmap.
+void Regex::match_batch(const std::string_view *inputs, size_t count,
+                        MatchSet *out, WorkPool *pool) const {
+  out->reset(count);
+  if (!pool)
+    pool = &WorkPool::shared();
+  // Only a yes or no is wanted, so a pattern with captures skips the
+  // Pike VM when its position automaton fits a word.
+  const PzRegex::GlushkovNFA &g = prog_->glushkov;
+  bool parallel = prog_->num_captures > 0 && g.parallel();
+  pool->parallelFor((count + 63) / 64, [&](size_t begin, size_t end) {
+    NFASimulator &sim = scratch();
+    for (size_t w = begin; w < end; w++) {
+      size_t base = w * 64;
+      size_t n = std::min<size_t>(64, count - base);
+      ut64 bits = 0;
+      for (size_t i = 0; i < n; i++) {
+        if (parallel ? g.match(inputs[base + i]) : sim.match(inputs[base + i]))
+          bits |= 1ULL << i;
+      }
+      out->words[w] = bits;
+    }
+  });
+}
+
+void Regex::search_batch(const std::string_view *inputs, size_t count,
+                         MatchSpan *spans, WorkPool *pool) const {
+  if (!pool)
+    pool = &WorkPool::shared();
+  pool->parallelFor(count, [&](size_t begin, size_t end) {
+    NFASimulator &sim = scratch();
+    for (size_t i = begin; i < end; i++)
+      spans[i] = sim.find(inputs[i]) ? sim.get_match_span() : MatchSpan();
+  });
+}
+
+std::unique_ptr<PzRegex::StreamMatcher> Regex::stream(bool anchored) const {
+  return std::make_unique<PzRegex::StreamMatcher>(prog_, anchored);
+}
@@ -0,0 +1,69 @@
+#include "NFA.hpp"
+
+typedef PzRegex::State State;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::NFABuilder NFABuilder;
+typedef PzRegex::NFASimulator NFASimulator;
+typedef PzRegex::LazyDFA LazyDFA;
+typedef PzRegex::MatchSet MatchSet;
+typedef PzRegex::RegexSet RegexSet;
+
+// MatchSet implementation
+void MatchSet::reset(size_t n) { words.assign((n + 63) / 64, 0); }
+
+void MatchSet::insert(ut32 id) {
+  if (id / 64 >= words.size())
+    words.resize(id / 64 + 1, 0);
+  words[id / 64] |= 1ULL << (id % 64);
+}
+
+bool MatchSet::contains(ut32 id) const {
+  return id / 64 < words.size() && ((words[id / 64] >> (id % 64)) & 1);
+}
+
+bool MatchSet::empty() const {
+  for (ut64 w : words) {
+    if (w)
+      return false;
+  }
+  return true;
+}
+
+size_t MatchSet::count() const {
+  size_t n = 0;
+  for (ut64 w : words) {
+    for (; w; w &= w - 1)
+      n++;
+  }
+  return n;
+}
+
+// RegexSet implementation
+RegexSet::RegexSet(const std::vector<std::string> &postfixes, bool useDfa)
+    : size_(postfixes.size()) {
+  std::vector<Prog> progs;
+  progs.reserve(postfixes.size());
+  for (const std::string &postfix : postfixes) {
+    NFABuilder builder;
+    State *start = builder.build(postfix);
+    progs.push_back(builder.compileBody(start));
+  }
+  prog_ = std::make_shared<const Prog>(Prog::join(progs));
+
+  if (useDfa)
+    dfa_ = std::make_unique<LazyDFA>(prog_, 4096, true);
+  else
+    nfa_ = std::make_unique<NFASimulator>(prog_);
+}
+
+size_t RegexSet::size() const { return size_; }
+
+bool RegexSet::match(std::string_view s, MatchSet *out) {
+  out->reset(size_);
+  return dfa_ ? dfa_->matchAll(s, true, out) : nfa_->matchAll(s, true, out);
+}
+
+bool RegexSet::search(std::string_view s, MatchSet *out) {
+  out->reset(size_);
+  return dfa_ ? dfa_->matchAll(s, false, out) : nfa_->matchAll(s, false, out);
+}
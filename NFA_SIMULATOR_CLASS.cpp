@@ -1,130 +1,520 @@
-#include "NFA.hpp"
-
-
-typedef PzRegex::State State;
-typedef PzRegex::StateType StateType;
-typedef PzRegex::AssertionType AssertionType;
-typedef PzRegex::CaptureGroup CaptureGroup;
-typedef PzRegex::NFASimulator NFASimulator;
-
-// List implementation
-void NFASimulator::List::clear() { items.clear(); }
-
-// NFASimulator implementation
-NFASimulator::NFASimulator(State *start, State *match, st32 numCaptures)
-    : start_(start), matchstate_(match), num_capture_groups_(numCaptures) {}
-
-void NFASimulator::addState(List *l, State *s, const std::string &input,
-                             st32 pos, std::vector<CaptureGroup> caps) {
-  if (!s || s->lastlist == listid_)
-    return;
-  s->lastlist = listid_;
-
-  if (s->type == StateType::STATE_SPLIT) {
-    // For non-greedy, try out1 (skip) before out (match)
-    if (s->greedy) {
-      addState(l, s->out, input, pos, caps);
-      addState(l, s->out1, input, pos, caps);
-    } else {
-      addState(l, s->out1, input, pos, caps);
-      addState(l, s->out, input, pos, caps);
-    }
-  } else if (s->type == StateType::STATE_ASSERTION) {
-    if (checkAssertion(s, input, pos)) {
-      addState(l, s->out, input, pos, caps);
-    }
-  } else if (s->type == StateType::STATE_CAPTURE_START) {
-    if (s->captureIndex < static_cast<st32>(caps.size())) {
-      caps[s->captureIndex].start_pos = pos;
-    }
-    addState(l, s->out, input, pos, caps);
-  } else if (s->type == StateType::STATE_CAPTURE_END) {
-    if (s->captureIndex < static_cast<st32>(caps.size())) {
-      caps[s->captureIndex].end_pos = pos;
-      caps[s->captureIndex].text =
-          input.substr(caps[s->captureIndex].start_pos,
-                       pos - caps[s->captureIndex].start_pos);
-    }
-    addState(l, s->out, input, pos, caps);
-  } else {
-    l->items.push_back({s, caps});
-  }
-}
-
-bool NFASimulator::checkAssertion(State *s, const std::string &input,
-                                   st32 pos) {
-  switch (s->assertion) {
-  case AssertionType::ASSERT_START_LINE:
-    return pos == 0;
-  case AssertionType::ASSERT_END_LINE:
-    return pos == static_cast<st32>(input.length());
-  case AssertionType::ASSERT_WORD_BOUND:
-    return isWordBoundary(input, pos);
-  default:
-    return true;
-  }
-}
-
-bool NFASimulator::isWordBoundary(const std::string &input, st32 pos) {
-  auto isWord = [](char c) -> bool { return isalnum(static_cast<ut8>(c)) || c == '_'; };
-  bool before = (pos > 0) && isWord(input[pos - 1]);
-  bool after = (pos < static_cast<st32>(input.length())) && isWord(input[pos]);
-  return before != after;
-}
-
-NFASimulator::List *NFASimulator::startList(State *s, List *l, st32 pos) {
-  listid_++;
-  l->clear();
-  std::vector<CaptureGroup> caps(num_capture_groups_);
-  addState(l, s, "", pos, caps);
-  return l;
-}
-
-void NFASimulator::step(List *clist, const std::string &input, st32 pos,
-                        List *nlist) {
-  listid_++;
-  nlist->clear();
-
-  for (auto &item : clist->items) {
-    State *s = item.state;
-    if (s->type == StateType::STATE_CHAR &&
-        s->c == static_cast<st32>(input[pos])) {
-      addState(nlist, s->out, input, pos + 1, item.caps);
-    } else if (s->type == StateType::STATE_CHARCLASS &&
-               s->charClass->matches(input[pos])) {
-      addState(nlist, s->out, input, pos + 1, item.caps);
-    }
-  }
-}
-
-bool NFASimulator::isMatch(List *l, const std::string &input, st32 pos) {
-  for (auto &item : l->items) {
-    if (item.state == matchstate_) {
-      captures_ = item.caps;
-      return true;
-    }
-  }
-  return false;
-}
-
-bool NFASimulator::match(const std::string &s) {
-  captures_.clear();
-  captures_.resize(num_capture_groups_);
-
-  List *clist = startList(start_, &l1_, 0);
-  List *nlist = &l2_;
-
-  for (size_t pos = 0; pos < s.length(); pos++) {
-    step(clist, s, static_cast<st32>(pos), nlist);
-    std::swap(clist, nlist);
-  }
-
-  return isMatch(clist, s, static_cast<st32>(s.length()));
-}
-
-std::string NFASimulator::get_capture(st32 index) const {
-  if (index >= 0 && index < static_cast<st32>(captures_.size())) {
-    return captures_[index].text;
-  }
-  return "";
-}
\ No newline at end of file
+#include "NFA.hpp"
+
+
+typedef PzRegex::CharClass CharClass;
+typedef PzRegex::State State;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::AssertionType AssertionType;
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::Prefilter Prefilter;
+typedef PzRegex::GlushkovNFA GlushkovNFA;
+typedef PzRegex::NFASimulator NFASimulator;
+typedef PzRegex::Backtracker Backtracker;
+typedef PzRegex::MatchSpan MatchSpan;
+typedef PzRegex::MatchSet MatchSet;
+
+// ThreadList implementation
+void NFASimulator::ThreadList::init(ut32 n) {
+  sparse.assign(n, 0);
+  dense.resize(n);
+  size = 0;
+}
+
+bool NFASimulator::ThreadList::contains(ut32 pc) const {
+  ut32 i = sparse[pc];
+  return i < size && dense[i].pc == pc;
+}
+
+NFASimulator::Thread &NFASimulator::ThreadList::insert(ut32 pc) {
+  sparse[pc] = size;
+  Thread &t = dense[size++];
+  t.pc = pc;
+  t.slots = kNoSlots;
+  return t;
+}
+
+void NFASimulator::ThreadList::clear() { size = 0; }
+
+// SlotSlab implementation
+void NFASimulator::SlotSlab::init(ut32 w, ut32 reserve) {
+  width = w;
+  slots.clear();
+  refs.clear();
+  free_list.clear();
+  if (width == 0)
+    return;
+  slots.reserve(static_cast<size_t>(width) * reserve);
+  refs.reserve(reserve);
+  free_list.reserve(reserve);
+}
+
+ut32 NFASimulator::SlotSlab::alloc() {
+  if (width == 0)
+    return 0;
+  ut32 h;
+  if (!free_list.empty()) {
+    h = free_list.back();
+    free_list.pop_back();
+  } else {
+    h = static_cast<ut32>(refs.size());
+    refs.push_back(0);
+    slots.resize(slots.size() + width);
+  }
+  refs[h] = 1;
+  return h;
+}
+
+ut32 NFASimulator::SlotSlab::copy(ut32 h) {
+  if (width == 0)
+    return 0;
+  ut32 n = alloc();
+  std::copy_n(&slots[static_cast<size_t>(h) * width], width,
+              &slots[static_cast<size_t>(n) * width]);
+  return n;
+}
+
+void NFASimulator::SlotSlab::incref(ut32 h) {
+  if (width != 0)
+    refs[h]++;
+}
+
+void NFASimulator::SlotSlab::decref(ut32 h) {
+  if (width != 0 && --refs[h] == 0)
+    free_list.push_back(h);
+}
+
+st64 *NFASimulator::SlotSlab::get(ut32 h) {
+  return width == 0 ? nullptr : &slots[static_cast<size_t>(h) * width];
+}
+
+// NFASimulator implementation
+NFASimulator::NFASimulator(std::shared_ptr<const Prog> prog)
+    : prog_(std::move(prog)), backtrack_(prog_) {
+  l1_.init(prog_->ids());
+  l2_.init(prog_->ids());
+  slab_.init(static_cast<ut32>(2 * prog_->num_captures + 2),
+             2 * prog_->ids() + 1);
+  // Every thread id is entered once per closure and pushes at most two
+  // frames, so this never grows
+  stack_.reserve(2 * prog_->ids() + 1);
+  if (prog_->num_captures == 0)
+    dfa_ = std::make_unique<PzRegex::LazyDFA>(prog_);
+  if (!prog_->onepass.empty())
+    pass_slots_.resize(prog_->onepass.width());
+}
+
+NFASimulator::NFASimulator(State *start, State *match, st32 numCaptures,
+                           const std::vector<CharClass> &classes)
+    : NFASimulator(std::make_shared<const Prog>(
+          Prog::compile(start, match, numCaptures, classes))) {}
+
+// Depth-first ε-closure on an explicit stack, so deep or wide patterns
+// cannot overflow the thread stack. Children are pushed in reverse
+// priority order, which visits them in the same order as recursion would.
+// A capture pushes a release frame below its successor: the private slot
+// copy stays referenced until everything reached through it is done.
+void NFASimulator::addThread(ThreadList *l, ut32 pc, ut32 slots, Edge edge,
+                             st64 pos) {
+  stack_.clear();
+  stack_.push_back({pc, slots});
+
+  while (!stack_.empty()) {
+    Frame f = stack_.back();
+    stack_.pop_back();
+    if (f.pc == kRelease) {
+      slab_.decref(f.slots);
+      continue;
+    }
+    if (f.pc == Prog::kNone || l->contains(f.pc))
+      continue;
+    Thread &t = l->insert(f.pc);
+    ut32 count;
+    const Inst &inst = prog_->insts[prog_->pcOf(f.pc, &count)];
+
+    switch (inst.type()) {
+    case StateType::STATE_SPLIT:
+      // For non-greedy, try out1 (skip) before out (match)
+      if (inst.greedy) {
+        stack_.push_back({inst.out1, f.slots});
+        stack_.push_back({inst.out, f.slots});
+      } else {
+        stack_.push_back({inst.out, f.slots});
+        stack_.push_back({inst.out1, f.slots});
+      }
+      break;
+    case StateType::STATE_ASSERTION:
+      if (checkAssertion(inst, edge))
+        stack_.push_back({inst.out, f.slots});
+      break;
+    case StateType::STATE_CAPTURE_START:
+    case StateType::STATE_CAPTURE_END: {
+      if (inst.arg < 0 || inst.arg > prog_->num_captures) {
+        stack_.push_back({inst.out, f.slots});
+        break;
+      }
+      // Copy on write: the incoming array may be shared with other threads
+      ut32 own = slab_.copy(f.slots);
+      bool end = inst.type() == StateType::STATE_CAPTURE_END;
+      slab_.get(own)[2 * inst.arg + (end ? 1 : 0)] = pos;
+      stack_.push_back({kRelease, own});
+      stack_.push_back({inst.out, own});
+      break;
+    }
+    case StateType::STATE_REPEAT: {
+      // Always greedy: another byte ranks above leaving
+      const Prog::Repeat &r = prog_->repeats[inst.arg];
+      if (count < r.max) {
+        t.slots = f.slots;
+        slab_.incref(f.slots);
+      }
+      if (count >= r.min)
+        stack_.push_back({inst.out, f.slots});
+      break;
+    }
+    default: // STATE_CHAR, STATE_CHARCLASS, STATE_MATCH
+      t.slots = f.slots;
+      slab_.incref(f.slots);
+      break;
+    }
+  }
+}
+
+static bool isWordByte(st32 b) {
+  return b >= 0 && b < 256 && (isalnum(b) || b == '_');
+}
+
+// The bytes on either side of pos; kNoByte past either end of the input.
+NFASimulator::Edge NFASimulator::edgeAt(std::string_view input, st64 pos) {
+  Edge edge;
+  edge.prev = pos > 0 ? static_cast<ut8>(input[pos - 1]) : kNoByte;
+  edge.next = pos < static_cast<st64>(input.length())
+                  ? static_cast<ut8>(input[pos])
+                  : kNoByte;
+  return edge;
+}
+
+bool NFASimulator::checkAssertion(const Inst &inst, Edge edge) {
+  switch (static_cast<AssertionType>(inst.arg)) {
+  case AssertionType::ASSERT_START_LINE:
+    return edge.prev == kNoByte;
+  case AssertionType::ASSERT_END_LINE:
+    return edge.next == kNoByte;
+  case AssertionType::ASSERT_WORD_BOUND:
+    return isWordByte(edge.prev) != isWordByte(edge.next);
+  default:
+    return true;
+  }
+}
+
+// Threads are visited in priority order. With stopAtMatch set, a thread
+// sitting on the match instruction records the match and cuts every
+// lower-priority thread, which gives leftmost-first semantics.
+bool NFASimulator::step(ThreadList *clist, ThreadList *nlist,
+                        std::string_view input, st64 pos, bool stopAtMatch) {
+  st32 byte = static_cast<ut8>(input[pos]);
+  Edge edge = edgeAt(input, pos + 1);
+  bool matched = false;
+
+  for (ut32 i = 0; i < clist->size; i++) {
+    const Thread &t = clist->dense[i];
+    if (t.slots == kNoSlots)
+      continue;
+    if (t.pc == prog_->match) {
+      if (stopAtMatch) {
+        recordMatch(t.slots, pos);
+        matched = true;
+        break;
+      }
+      continue;
+    }
+    const Inst &inst = prog_->insts[prog_->pcOf(t.pc)];
+    if ((inst.type() == StateType::STATE_CHAR && inst.arg == byte) ||
+        (inst.type() == StateType::STATE_CHARCLASS &&
+         prog_->classes[inst.arg].matches(input[pos]))) {
+      addThread(nlist, inst.out, t.slots, edge, pos + 1);
+    } else if (inst.type() == StateType::STATE_REPEAT &&
+               prog_->classes[prog_->repeats[inst.arg].cls].matches(
+                   input[pos])) {
+      addThread(nlist, prog_->advance(t.pc), t.slots, edge, pos + 1);
+    }
+  }
+  release(clist);
+  return matched;
+}
+
+bool NFASimulator::finish(ThreadList *clist, st64 pos) {
+  bool matched = false;
+  for (ut32 i = 0; i < clist->size; i++) {
+    if (clist->dense[i].pc == prog_->match) {
+      recordMatch(clist->dense[i].slots, pos);
+      matched = true;
+      break;
+    }
+  }
+  release(clist);
+  return matched;
+}
+
+void NFASimulator::recordMatch(ut32 slots, st64 pos) {
+  st64 *p = slab_.get(slots);
+  match_slots_.assign(p, p + slab_.width);
+  match_slots_[2 * prog_->num_captures + 1] = pos;
+}
+
+void NFASimulator::release(ThreadList *l) {
+  for (ut32 i = 0; i < l->size; i++) {
+    if (l->dense[i].slots != kNoSlots)
+      slab_.decref(l->dense[i].slots);
+  }
+  l->clear();
+}
+
+bool NFASimulator::match(std::string_view s) {
+  input_ = s;
+  match_slots_.clear();
+  if (dfa_ && fast_) {
+    if (!dfa_->match(s))
+      return false;
+    match_slots_.assign(slab_.width, -1);
+    match_slots_[2 * prog_->num_captures] = 0;
+    match_slots_[2 * prog_->num_captures + 1] = static_cast<st64>(s.length());
+    return true;
+  }
+  if (fast_ && !prog_->onepass.empty()) {
+    size_t work = 0;
+    match_slots_.resize(slab_.width);
+    if (prog_->onepass.exec(s, 0, true, pass_slots_.data(),
+                            match_slots_.data(), &work))
+      return true;
+    match_slots_.clear();
+    return false;
+  }
+  // Inputs that do not match never pay for capture tracking
+  if (fast_ && prog_->glushkov.parallel() && !prog_->glushkov.match(s))
+    return false;
+  if (fast_ && backtrack_.fits(s.length())) {
+    match_slots_.resize(slab_.width);
+    if (backtrack_.match(s, match_slots_.data()))
+      return true;
+    match_slots_.clear();
+    return false;
+  }
+
+  ThreadList *clist = &l1_;
+  ThreadList *nlist = &l2_;
+  clist->clear();
+  nlist->clear();
+
+  ut32 init = slab_.alloc();
+  std::fill_n(slab_.get(init), slab_.width, -1);
+  slab_.get(init)[2 * prog_->num_captures] = 0;
+  addThread(clist, prog_->start, init, edgeAt(s, 0), 0);
+  slab_.decref(init);
+
+  for (size_t pos = 0; pos < s.length() && clist->size > 0; pos++) {
+    step(clist, nlist, s, static_cast<st64>(pos), false);
+    std::swap(clist, nlist);
+  }
+
+  return finish(clist, static_cast<st64>(s.length()));
+}
+
+void NFASimulator::seed(ThreadList *l, ut32 pc, Edge edge, st64 pos) {
+  ut32 init = slab_.alloc();
+  std::fill_n(slab_.get(init), slab_.width, -1);
+  addThread(l, pc, init, edge, pos);
+  slab_.decref(init);
+}
+
+bool NFASimulator::search(std::string_view s, size_t from) {
+  input_ = s;
+  match_slots_.clear();
+  if (from > s.length())
+    return false;
+  if (fast_ && !prog_->onepass.empty() && onePassSearch(s, &from))
+    return !match_slots_.empty();
+  if (fast_ && backtrack_.fits(s.length() - from)) {
+    match_slots_.resize(slab_.width);
+    if (backtrack_.search(s, from, match_slots_.data()))
+      return true;
+    match_slots_.clear();
+    return false;
+  }
+
+  ThreadList *clist = &l1_;
+  ThreadList *nlist = &l2_;
+  clist->clear();
+  nlist->clear();
+
+  const PzRegex::Prefilter &pf = prog_->prefilter;
+  bool matched = false;
+
+  if (pf.empty()) {
+    // One pass: the .*? loop keeps seeding new start positions at lower
+    // priority until a match cuts it off.
+    seed(clist, prog_->unanchored, edgeAt(s, from), static_cast<st64>(from));
+    for (size_t pos = from; pos < s.length() && clist->size > 0; pos++) {
+      if (step(clist, nlist, s, static_cast<st64>(pos), true))
+        matched = true;
+      std::swap(clist, nlist);
+    }
+    if (finish(clist, static_cast<st64>(s.length())))
+      matched = true;
+    return matched;
+  }
+
+  // Every match starts with a required literal, so threads are only seeded
+  // where the prefilter finds one, and dead stretches are skipped outright.
+  ut32 span = prog_->insts[prog_->unanchored].out1;
+  size_t next = pf.find(s, from);
+  size_t pos = from;
+  for (;;) {
+    if (!matched && clist->size == 0) {
+      if (next == Prefilter::npos)
+        break;
+      pos = next;
+    }
+    if (!matched && pos == next) {
+      seed(clist, span, edgeAt(s, pos), static_cast<st64>(pos));
+      next = pf.find(s, pos + 1);
+    }
+    if (pos >= s.length() || clist->size == 0)
+      break;
+    if (step(clist, nlist, s, static_cast<st64>(pos), true))
+      matched = true;
+    std::swap(clist, nlist);
+    pos++;
+  }
+
+  if (finish(clist, static_cast<st64>(pos)))
+    matched = true;
+  return matched;
+}
+
+// Without a reversed program (set programs, or a Prog built by hand)
+// this is plain search().
+bool NFASimulator::find(std::string_view s, size_t from) {
+  if (!fast_ || !prog_->reverse || prog_->match == Prog::kNone)
+    return search(s, from);
+  input_ = s;
+  match_slots_.clear();
+  if (from > s.length())
+    return false;
+
+  const PzRegex::Prefilter &pf = prog_->prefilter;
+  if (!pf.empty()) {
+    from = pf.find(s, from);
+    if (from == Prefilter::npos)
+      return false;
+  }
+  if (!end_dfa_) {
+    end_dfa_ = std::make_unique<PzRegex::LazyDFA>(prog_, 4096, false, true);
+    start_dfa_ =
+        std::make_unique<PzRegex::LazyDFA>(prog_->reverse, 4096, true);
+  }
+  size_t end = end_dfa_->findEnd(s, from);
+  if (end == std::string_view::npos)
+    return false;
+  size_t start = start_dfa_->findStart(s, end, from);
+
+  match_slots_.assign(slab_.width, -1);
+  match_slots_[2 * prog_->num_captures] = static_cast<st64>(start);
+  match_slots_[2 * prog_->num_captures + 1] = static_cast<st64>(end);
+  return true;
+}
+
+// Anchored runs at each candidate start in turn: the first that matches
+// holds the leftmost match. Input that keeps almost matching makes that
+// quadratic, so after kOnePassBudget bytes per input byte the rest is left
+// to the Pike VM, from the first start not yet tried.
+bool NFASimulator::onePassSearch(std::string_view s, size_t *from) {
+  const PzRegex::Prefilter &pf = prog_->prefilter;
+  size_t budget = kOnePassBudget * (s.length() - *from + 1);
+  size_t work = 0;
+  match_slots_.resize(slab_.width);
+  size_t at = pf.empty() ? *from : pf.find(s, *from);
+  while (at != Prefilter::npos && at <= s.length()) {
+    if (prog_->onepass.exec(s, at, false, pass_slots_.data(),
+                            match_slots_.data(), &work))
+      return true;
+    if (++work > budget && at < s.length()) {
+      match_slots_.clear();
+      *from = at + 1;
+      return false;
+    }
+    at = pf.empty() ? at + 1 : pf.find(s, at + 1);
+  }
+  match_slots_.clear();
+  return true;
+}
+
+void NFASimulator::collect(const ThreadList *l, MatchSet *out) const {
+  for (ut32 i = 0; i < l->size; i++) {
+    const Inst &inst = prog_->insts[prog_->pcOf(l->dense[i].pc)];
+    if (inst.type() == StateType::STATE_MATCH)
+      out->insert(static_cast<ut32>(inst.arg));
+  }
+}
+
+// Every thread runs to completion; nothing is cut at a match, so each
+// pattern of a set program reports independently of the others. The
+// GlushkovNFA of the joined program first checks that any of them can.
+bool NFASimulator::matchAll(std::string_view s, bool anchored,
+                            MatchSet *out) {
+  input_ = s;
+  match_slots_.clear();
+  const GlushkovNFA &g = prog_->glushkov;
+  if (fast_ && g.parallel() && !(anchored ? g.match(s) : g.search(s)))
+    return false;
+
+  ThreadList *clist = &l1_;
+  ThreadList *nlist = &l2_;
+  clist->clear();
+  nlist->clear();
+
+  seed(clist, anchored ? prog_->start : prog_->unanchored, edgeAt(s, 0), 0);
+  for (size_t pos = 0; pos < s.length() && clist->size > 0; pos++) {
+    if (!anchored)
+      collect(clist, out);
+    step(clist, nlist, s, static_cast<st64>(pos), false);
+    std::swap(clist, nlist);
+  }
+  collect(clist, out);
+  release(clist);
+  return !out->empty();
+}
+
+MatchSpan NFASimulator::get_match_span() const {
+  MatchSpan span;
+  if (match_slots_.empty())
+    return span;
+  span.start = match_slots_[2 * prog_->num_captures];
+  span.end = match_slots_[2 * prog_->num_captures + 1];
+  return span;
+}
+
+std::string NFASimulator::get_capture(st32 index) const {
+  if (index < 0 || 2 * index + 1 >= static_cast<st32>(match_slots_.size()))
+    return "";
+  st64 start = match_slots_[2 * index];
+  st64 end = match_slots_[2 * index + 1];
+  if (start < 0 || end < start)
+    return "";
+  return std::string(input_.substr(start, end - start));
+}
+
+MatchSpan NFASimulator::get_capture_span(st32 index) const {
+  MatchSpan span;
+  if (index < 0 || 2 * static_cast<size_t>(index) + 1 >= match_slots_.size())
+    return span;
+  span.start = match_slots_[2 * index];
+  span.end = match_slots_[2 * index + 1];
+  return span;
+}
+
+void NFASimulator::set_backtrack_budget(size_t bits) {
+  backtrack_ = Backtracker(prog_, bits);
+}
+
+void NFASimulator::set_fast_paths(bool on) { fast_ = on; }
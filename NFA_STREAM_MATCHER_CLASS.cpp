@@ -0,0 +1,154 @@
+#include "NFA.hpp"
+
+typedef PzRegex::Inst Inst;
+typedef PzRegex::Prog Prog;
+typedef PzRegex::StateType StateType;
+typedef PzRegex::LazyDFA LazyDFA;
+typedef PzRegex::NFASimulator NFASimulator;
+typedef PzRegex::MatchSpan MatchSpan;
+typedef PzRegex::StreamMatcher StreamMatcher;
+
+// StreamMatcher implementation
+StreamMatcher::StreamMatcher(std::shared_ptr<const Prog> prog, bool anchored)
+    : prog_(prog), sim_(std::move(prog)), anchored_(anchored),
+      use_dfa_(anchored && sim_.dfa_ != nullptr) {
+  reset();
+}
+
+void StreamMatcher::dropPending() {
+  for (const NFASimulator::Thread &t : pending_)
+    sim_.slab_.decref(t.slots);
+  pending_.clear();
+}
+
+void StreamMatcher::reset() {
+  dropPending();
+  sim_.match_slots_.clear();
+  pos_ = 0;
+  prev_ = NFASimulator::kNoByte;
+  matched_ = false;
+  finished_ = false;
+
+  if (use_dfa_) {
+    dstate_ = sim_.dfa_->startState(true);
+    return;
+  }
+
+  // The anchored start gets its span opened here; the unanchored entry
+  // opens it itself each time its loop tries a new start position.
+  ut32 init = sim_.slab_.alloc();
+  std::fill_n(sim_.slab_.get(init), sim_.slab_.width, -1);
+  if (anchored_)
+    sim_.slab_.get(init)[2 * prog_->num_captures] = 0;
+  pending_.push_back({anchored_ ? prog_->start : prog_->unanchored, init});
+}
+
+// One step of NFASimulator::step with the closure moved to the front: the
+// threads left by the previous byte are expanded now that the byte after
+// them is known, then the byte itself is consumed.
+void StreamMatcher::consume(st32 byte) {
+  NFASimulator::ThreadList *clist = &sim_.l1_;
+  NFASimulator::Edge edge = {prev_, byte};
+  clist->clear();
+  for (const NFASimulator::Thread &t : pending_) {
+    sim_.addThread(clist, t.pc, t.slots, edge, static_cast<st64>(pos_));
+    sim_.slab_.decref(t.slots);
+  }
+  pending_.clear();
+
+  for (ut32 i = 0; i < clist->size; i++) {
+    const NFASimulator::Thread &t = clist->dense[i];
+    if (t.slots == NFASimulator::kNoSlots)
+      continue;
+    if (t.pc == prog_->match) {
+      if (!anchored_) {
+        // Leftmost-first: lower-priority threads are cut off
+        sim_.recordMatch(t.slots, static_cast<st64>(pos_));
+        matched_ = true;
+        break;
+      }
+      continue;
+    }
+    const Inst &inst = prog_->insts[prog_->pcOf(t.pc)];
+    if ((inst.type() == StateType::STATE_CHAR && inst.arg == byte) ||
+        (inst.type() == StateType::STATE_CHARCLASS &&
+         prog_->classes[inst.arg].matches(static_cast<char>(byte)))) {
+      sim_.slab_.incref(t.slots);
+      pending_.push_back({inst.out, t.slots});
+    } else if (inst.type() == StateType::STATE_REPEAT &&
+               prog_->classes[prog_->repeats[inst.arg].cls].matches(
+                   static_cast<char>(byte))) {
+      sim_.slab_.incref(t.slots);
+      pending_.push_back({prog_->advance(t.pc), t.slots});
+    }
+  }
+  sim_.release(clist);
+}
+
+void StreamMatcher::feed(std::string_view chunk) {
+  if (finished_)
+    PzError::report_error(PzError::PzErrorType::PZ_WRONG_ARGS,
+                          "StreamMatcher::feed called after finish");
+
+  size_t i = 0;
+  if (use_dfa_) {
+    for (; i < chunk.length() && dstate_ != LazyDFA::kDead; i++)
+      dstate_ = sim_.dfa_->step(dstate_, static_cast<ut8>(chunk[i]));
+  } else {
+    for (; i < chunk.length() && !pending_.empty(); i++) {
+      consume(static_cast<ut8>(chunk[i]));
+      prev_ = static_cast<ut8>(chunk[i]);
+      pos_++;
+    }
+  }
+
+  // Once nothing is alive the rest only moves the offset
+  if (!chunk.empty())
+    prev_ = static_cast<ut8>(chunk.back());
+  pos_ += chunk.length() - (use_dfa_ ? 0 : i);
+}
+
+bool StreamMatcher::finish() {
+  if (finished_)
+    return matched_;
+  finished_ = true;
+
+  if (use_dfa_) {
+    matched_ = dstate_ != LazyDFA::kDead && sim_.dfa_->acceptsAtEnd(dstate_);
+    if (matched_) {
+      sim_.match_slots_.assign(sim_.slab_.width, -1);
+      sim_.match_slots_[2 * prog_->num_captures] = 0;
+      sim_.match_slots_[2 * prog_->num_captures + 1] =
+          static_cast<st64>(pos_);
+    }
+    return matched_;
+  }
+
+  NFASimulator::ThreadList *clist = &sim_.l1_;
+  NFASimulator::Edge edge = {prev_, NFASimulator::kNoByte};
+  clist->clear();
+  for (const NFASimulator::Thread &t : pending_) {
+    sim_.addThread(clist, t.pc, t.slots, edge, static_cast<st64>(pos_));
+    sim_.slab_.decref(t.slots);
+  }
+  pending_.clear();
+  if (sim_.finish(clist, static_cast<st64>(pos_)))
+    matched_ = true;
+  return matched_;
+}
+
+ut64 StreamMatcher::offset() const { return pos_; }
+
+MatchSpan StreamMatcher::get_match_span() const {
+  return sim_.get_match_span();
+}
+
+MatchSpan StreamMatcher::get_capture_span(st32 index) const {
+  MatchSpan span;
+  const std::vector<st64> &slots = sim_.match_slots_;
+  if (index < 0 || 2 * static_cast<size_t>(index) + 1 >= slots.size())
+    return span;
+  span.start = slots[2 * index];
+  span.end = slots[2 * index + 1];
+  return span;
+}
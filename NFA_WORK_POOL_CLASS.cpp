@@ -0,0 +1,139 @@
+#include "NFA.hpp"
+
+typedef PzRegex::WorkPool WorkPool;
+
+// WorkPool implementation
+WorkPool::WorkPool(size_t threads) {
+  if (threads == 0)
+    threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+  participants_ = threads;
+  ranges_ = std::make_unique<Range[]>(participants_);
+  for (size_t slot = 1; slot < participants_; slot++)
+    workers_.emplace_back([this, slot] { workerLoop(slot); });
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> lk(state_lock_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : workers_)
+    t.join();
+}
+
+size_t WorkPool::size() const { return participants_; }
+
+WorkPool &WorkPool::shared() {
+  static WorkPool pool;
+  return pool;
+}
+
+void WorkPool::workerLoop(size_t slot) {
+  ut64 seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lk(state_lock_);
+      wake_.wait(lk, [&] { return stop_ || generation_ != seen; });
+      if (stop_)
+        return;
+      seen = generation_;
+    }
+    runSlot(slot);
+    std::lock_guard<std::mutex> lk(state_lock_);
+    if (--active_ == 0)
+      done_.notify_one();
+  }
+}
+
+// Guided chunking: take a share of what is left, so early chunks are big
+// and the tail is handed out in small pieces.
+bool WorkPool::nextChunk(size_t slot, size_t *begin, size_t *end) {
+  Range &r = ranges_[slot];
+  std::lock_guard<std::mutex> lk(r.lock);
+  size_t left = r.end - r.begin;
+  if (left == 0)
+    return false;
+  size_t chunk = std::max<size_t>(1, left / (2 * participants_));
+  *begin = r.begin;
+  *end = r.begin + chunk;
+  r.begin += chunk;
+  return true;
+}
+
+// Move the upper half of the first non-empty victim range to slot. Only
+// one range lock is held at a time.
+bool WorkPool::steal(size_t slot) {
+  for (size_t i = 1; i < participants_; i++) {
+    Range &victim = ranges_[(slot + i) % participants_];
+    size_t from, to;
+    {
+      std::lock_guard<std::mutex> lk(victim.lock);
+      size_t left = victim.end - victim.begin;
+      if (left == 0)
+        continue;
+      to = victim.end;
+      from = to - (left + 1) / 2;
+      victim.end = from;
+    }
+    Range &own = ranges_[slot];
+    std::lock_guard<std::mutex> lk(own.lock);
+    own.begin = from;
+    own.end = to;
+    return true;
+  }
+  return false;
+}
+
+void WorkPool::runSlot(size_t slot) {
+  try {
+    size_t begin, end;
+    do {
+      while (nextChunk(slot, &begin, &end))
+        (*fn_)(begin, end);
+    } while (steal(slot));
+  } catch (...) {
+    std::lock_guard<std::mutex> lk(state_lock_);
+    if (!error_)
+      error_ = std::current_exception();
+  }
+}
+
+void WorkPool::parallelFor(size_t n,
+                           const std::function<void(size_t, size_t)> &fn) {
+  if (n == 0)
+    return;
+  std::lock_guard<std::mutex> run(run_lock_);
+  if (participants_ == 1 || n == 1) {
+    fn(0, n);
+    return;
+  }
+
+  for (size_t slot = 0; slot < participants_; slot++) {
+    std::lock_guard<std::mutex> lk(ranges_[slot].lock);
+    ranges_[slot].begin = n * slot / participants_;
+    ranges_[slot].end = n * (slot + 1) / participants_;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(state_lock_);
+    fn_ = &fn;
+    error_ = nullptr;
+    active_ = participants_;
+    generation_++;
+  }
+  wake_.notify_all();
+
+  runSlot(0);
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lk(state_lock_);
+    active_--;
+    done_.wait(lk, [&] { return active_ == 0; });
+    fn_ = nullptr;
+    error = error_;
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
@@ -3,19 +3,33 @@
 
 // All standard C++ libraries used for project
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <set>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
 
 #endif // PZ_CXX_STD_HPP
\ No newline at end of file